@@ -87,6 +87,14 @@ namespace thera {
 			virtual double getDouble(const QString &field, double deflt = 0.0) const = 0;
 			virtual int getInt(const QString &field, int deflt = 0) const = 0;
 
+			// same as above, but with an interned field id (see fieldId()) which saves the string lookups in hot paths
+			virtual QString getString(int fieldId, const QString &deflt = "") const = 0;
+			virtual double getDouble(int fieldId, double deflt = 0.0) const = 0;
+			virtual int getInt(int fieldId, int deflt = 0) const = 0;
+
+			// the interned id of a field, for the getters above. It's the same for every match, so it can be looked up once up front
+			static int fieldId(const QString &field);
+
 			virtual const QString getTargetId() const { return (mFragments[TARGET] != -1) ? Database::entryID(mFragments[TARGET]) : QString(); }
 			virtual const QString getSourceId() const { return (mFragments[SOURCE] != -1) ? Database::entryID(mFragments[SOURCE]) : QString(); }
 
@@ -18,6 +18,9 @@ namespace thera {
 			virtual QString getString(const QString &field, const QString &deflt="") const { qDebug() << "InvalidFragmentConf::getString: " << field << "|" << deflt; return deflt; }
 			virtual double getDouble(const QString &field, double deflt=0.0) const { qDebug() << "InvalidFragmentConf::getDouble: " << field << "|" << deflt; return deflt; }
 			virtual int getInt(const QString &field, int deflt = 0) const { qDebug() << "InvalidFragmentConf::getInt: " << field << "|" << deflt; return deflt; };
+			virtual QString getString(int fieldId, const QString &deflt="") const { qDebug() << "InvalidFragmentConf::getString: " << fieldId << "|" << deflt; return deflt; }
+			virtual double getDouble(int fieldId, double deflt=0.0) const { qDebug() << "InvalidFragmentConf::getDouble: " << fieldId << "|" << deflt; return deflt; }
+			virtual int getInt(int fieldId, int deflt = 0) const { qDebug() << "InvalidFragmentConf::getInt: " << fieldId << "|" << deflt; return deflt; };
 
 			virtual const QString getTargetId() const { return QString(); }
 			virtual const QString getSourceId() const { return QString(); }
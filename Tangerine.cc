@@ -495,6 +495,13 @@ void Tangerine::keyPressEvent(QKeyEvent *event) {
 					benchmarker.setRepetitionConfigurations(repetitionConfigurations);
 
 					benchmarker.start("bench/bench.txt");
+					benchmarker.startFillBenchmark("bench/bench-fill.txt");
+					benchmarker.startViewBenchmark("bench/bench-views.txt");
+
+					benchmarker.startPlanBenchmark("bench/bench-plans.csv");
+					if (QFile::exists("bench/bench-plans-baseline.csv")) {
+						benchmarker.compareWithBaseline("bench/bench-plans-baseline.csv", "bench/bench-plans-regressions.txt");
+					}
 				}
 			}
 		} break;
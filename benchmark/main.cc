@@ -0,0 +1,220 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QMap>
+#include <QtAlgorithms>
+#include <QDebug>
+
+#include "SQLDatabase.h"
+#include "SQLDatabaseBenchmarker.h"
+#include "SQLSyntheticDataset.h"
+
+static const QString DEFAULT_DATABASE = "bench/bench.db";
+
+static void usage(QTextStream& out) {
+	out << "usage: tangerine-bench [options] [database]\n"
+		<< "\n"
+		<< "  database                a SQLite .db or a .dbd file, " << DEFAULT_DATABASE << " by default\n"
+		<< "\n"
+		<< "  -s, --scenario file     preloads, filters, sort fields and window walks (see benchmark/default.scenario)\n"
+		<< "  -r, --repetitions n     how many times every query runs, 5 by default\n"
+		<< "  -o, --output file       the records of the last repetition, JSON if it ends in .json and CSV otherwise\n"
+		<< "  -b, --baseline file     a CSV written by --output earlier, exits with 1 if there are regressions\n"
+		<< "  -g, --generate xml      fills an empty database with the matches in xml first, through stressTestFromXML\n"
+		<< "  -f, --factor n          how many times --generate repeats every match, 10 by default\n"
+		<< "  -n, --synthetic n       fills an empty database with n made-up matches first, see SQLSyntheticDataset\n"
+		<< "      --fragments m       the matches of --synthetic are between m fragments, 2000 by default\n"
+		<< "      --duplicates g      --synthetic makes g duplicate groups, 1 per 100 matches by default\n"
+		<< "      --conflicts c       --synthetic makes c conflicts, 1 per 200 matches by default\n"
+		<< "      --seed s            --synthetic makes the same matches for the same seed, 1 by default\n"
+		<< "  -h, --help\n"
+		<< "\n"
+		<< "a new database gets the schema in config/matches_schema.sql, relative to the working directory\n";
+}
+
+// nearest rank, expects a sorted list
+static double percentile(const QList<double>& sorted, double p) {
+	if (sorted.isEmpty()) return 0.0;
+
+	const int rank = qBound(0, int(p / 100.0 * sorted.size() + 0.5) - 1, sorted.size() - 1);
+
+	return sorted.at(rank);
+}
+
+static void printPercentiles(QTextStream& out, const QString& name, QList<double> msecs) {
+	qSort(msecs);
+
+	out << name << "\n\t"
+		<< msecs.size() << " queries, msec: "
+		<< "p50 " << percentile(msecs, 50)
+		<< ", p90 " << percentile(msecs, 90)
+		<< ", p99 " << percentile(msecs, 99)
+		<< ", max " << (msecs.isEmpty() ? 0.0 : msecs.last())
+		<< "\n";
+}
+
+int main(int argc, char *argv[]) {
+	QCoreApplication application(argc, argv);
+	QCoreApplication::setOrganizationName("kuleuven.be");
+	QCoreApplication::setOrganizationDomain("kuleuven.be");
+	QCoreApplication::setApplicationName("tangerine-bench");
+
+	QTextStream out(stdout);
+
+	QString database = DEFAULT_DATABASE;
+	QString scenario;
+	QString output;
+	QString baseline;
+	QString generate;
+	int factor = 10;
+	int synthetic = 0;
+	int fragments = 2000;
+	int duplicates = -1;
+	int conflicts = -1;
+	quint32 seed = 1;
+	int repetitions = 5;
+
+	const QStringList arguments = QCoreApplication::arguments();
+
+	for (int i = 1; i < arguments.size(); ++i) {
+		const QString argument = arguments.at(i);
+		const bool hasValue = i + 1 < arguments.size();
+
+		if (argument == "-h" || argument == "--help") {
+			usage(out);
+
+			return 0;
+		}
+		else if ((argument == "-s" || argument == "--scenario") && hasValue) scenario = arguments.at(++i);
+		else if ((argument == "-r" || argument == "--repetitions") && hasValue) repetitions = qMax(1, arguments.at(++i).toInt());
+		else if ((argument == "-o" || argument == "--output") && hasValue) output = arguments.at(++i);
+		else if ((argument == "-b" || argument == "--baseline") && hasValue) baseline = arguments.at(++i);
+		else if ((argument == "-g" || argument == "--generate") && hasValue) generate = arguments.at(++i);
+		else if ((argument == "-f" || argument == "--factor") && hasValue) factor = qMax(1, arguments.at(++i).toInt());
+		else if ((argument == "-n" || argument == "--synthetic") && hasValue) synthetic = qMax(0, arguments.at(++i).toInt());
+		else if (argument == "--fragments" && hasValue) fragments = qMax(2, arguments.at(++i).toInt());
+		else if (argument == "--duplicates" && hasValue) duplicates = qMax(0, arguments.at(++i).toInt());
+		else if (argument == "--conflicts" && hasValue) conflicts = qMax(0, arguments.at(++i).toInt());
+		else if (argument == "--seed" && hasValue) seed = arguments.at(++i).toUInt();
+		else if (!argument.startsWith("-")) database = argument;
+		else {
+			out << "unknown or incomplete option " << argument << "\n\n";
+			usage(out);
+
+			return 2;
+		}
+	}
+
+	QDir().mkpath(QFileInfo(database).absolutePath());
+
+	QSharedPointer<SQLDatabase> db = SQLDatabase::getDb(database);
+
+	if (db.isNull() || !db->isOpen()) {
+		out << "couldn't open database " << database << "\n";
+
+		return 2;
+	}
+
+	if (synthetic > 0) {
+		if (db->matchCount() == 0) {
+			SQLSyntheticDataset dataset(synthetic, fragments);
+			if (duplicates >= 0) dataset.duplicateGroups = duplicates;
+			if (conflicts >= 0) dataset.conflicts = conflicts;
+			dataset.seed = seed;
+
+			out << "generating " << synthetic << " matches between " << fragments << " fragments\n";
+			out.flush();
+
+			if (!db->generateMatches(dataset)) {
+				out << "couldn't generate the matches\n";
+
+				return 2;
+			}
+		}
+		else {
+			out << "database already has " << db->matchCount() << " matches, not generating any\n";
+		}
+	}
+	else if (!generate.isEmpty()) {
+		if (db->matchCount() == 0) {
+			out << "generating matches from " << generate << " (factor " << factor << ")\n";
+			out.flush();
+
+			db->stressTestFromXML(generate, factor);
+		}
+		else {
+			out << "database already has " << db->matchCount() << " matches, not generating any\n";
+		}
+	}
+
+	if (db->matchCount() == 0) {
+		out << "database " << database << " has no matches, nothing to benchmark\n";
+
+		return 2;
+	}
+
+	SQLDatabaseBenchmarker benchmarker(db.data());
+
+	// the defaults, for whatever the scenario doesn't specify
+	benchmarker.setPreloadConfigurations(QList<QStringList>());
+	benchmarker.setParameterConfigurations(QList<ModelParameters>());
+	benchmarker.setRepetitionConfigurations(QList< QList< QPair<int, int> > >());
+
+	if (!scenario.isEmpty() && !benchmarker.loadScenario(scenario)) {
+		out << "couldn't load scenario " << scenario << "\n";
+
+		return 2;
+	}
+
+	// configuration -> pass -> latencies over all repetitions
+	QMap<QString, QMap<QString, QList<double> > > latencies;
+	QList<double> all;
+
+	const QString records = output.isEmpty() ? QDir::temp().filePath("tangerine-bench.csv") : output;
+
+	for (int r = 0; r < repetitions; ++r) {
+		out << "repetition " << (r + 1) << " of " << repetitions << "\n";
+		out.flush();
+
+		if (!benchmarker.startPlanBenchmark(records)) {
+			out << "couldn't write " << records << "\n";
+
+			return 2;
+		}
+
+		foreach (const SQLDatabaseBenchmarker::QueryRecord& record, benchmarker.records()) {
+			latencies[record.configuration][record.paginated ? "paginated" : "absolute"] << record.msec;
+			all << record.msec;
+		}
+	}
+
+	out << "\n" << db->matchCount() << " matches, " << repetitions << " repetitions\n\n";
+
+	for (QMap<QString, QMap<QString, QList<double> > >::const_iterator i = latencies.constBegin(); i != latencies.constEnd(); ++i) {
+		for (QMap<QString, QList<double> >::const_iterator j = i.value().constBegin(); j != i.value().constEnd(); ++j) {
+			printPercentiles(out, i.key() + " " + j.key(), j.value());
+		}
+	}
+
+	printPercentiles(out, "\nall", all);
+
+	int regressions = 0;
+
+	if (!baseline.isEmpty()) {
+		const QString report = QFileInfo(records).absoluteDir().filePath("tangerine-bench-regressions.txt");
+
+		regressions = benchmarker.compareWithBaseline(baseline, report);
+
+		if (regressions < 0) {
+			out << "couldn't read baseline " << baseline << "\n";
+
+			return 2;
+		}
+
+		out << "\n" << regressions << " regressions against " << baseline << ", see " << report << "\n";
+	}
+
+	return (regressions > 0) ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+REPOSDIR=../../..
+include( $${REPOSDIR}/src/admin/app-common.pri )
+
+#---------------
+
+# the benchmark driver, runs SQLDatabaseBenchmarker without any of the GUI so it works without a display
+
+TARGET    = tangerine-bench
+CONFIG   += qt console
+CONFIG   -= app_bundle
+
+QT += xml sql
+
+SOURCES     = main.cc
+INCLUDEPATH += ..
+
+SOURCES += ../sql/*.cc
+HEADERS += ../sql/*.h
+INCLUDEPATH += ../sql
+
+# only for the headers (ModelParameters and what it includes)
+INCLUDEPATH += ../models
+
+DESTDIR = $${REPOSDIR}/bin/$${UNAME}.$${DBGNAME}
+
+LIBS += $${THERACORELIB}
+LIBS += $${THERATYPESLIB}
+LIBS += $${TRIMESHLIB}   # has to come last
+
+DEPENDPATH += $${INCLUDEPATH}
+DEPENDPATH += $${REPOSDIR}/lib/$${UNAME}.$${DBGNAME}
@@ -39,15 +39,18 @@ void AttributeMerger::merge(SQLDatabase *left, SQLDatabase *right) {
 	IdToHistoryMap rightIdToHistoryMap;
 
 	foreach (const QString& attribute, attributes) {
-		QList<HistoryRecord> leftHistory = left->getHistory(attribute, "timestamp", Qt::AscendingOrder);
-		QList<HistoryRecord> rightHistory = right->getHistory(attribute, "timestamp", Qt::AscendingOrder);
-
 		leftIdToHistoryMap.clear();
 		rightIdToHistoryMap.clear();
 
-		fillHistoryMap(leftIdToHistoryMap, leftHistory, false); // non-mapped
+		QList<HistoryRecord> rightHistory = right->getHistory(attribute, QList<int>());
 		fillHistoryMap(rightIdToHistoryMap, rightHistory, true); // mapped
 
+		// only the history of the matches that are merged in is needed on the left side
+		if (!rightIdToHistoryMap.isEmpty()) {
+			QList<HistoryRecord> leftHistory = left->getHistory(attribute, rightIdToHistoryMap.keys());
+			fillHistoryMap(leftIdToHistoryMap, leftHistory, false); // non-mapped
+		}
+
 		//qDebug() << "AttributeMerger::merge: master map size =" << leftIdToHistoryMap.size() << ", slave map size =" << rightIdToHistoryMap.size();
 
 		// TODO: assert / sanity check to see if the list contains duplicate pointers
@@ -23,7 +23,7 @@
 
 using namespace thera;
 
-GraphView::GraphView(QWidget *parent) : QGraphicsView(parent), mGraph(NULL), mModel(NULL), mDirty(false) {
+GraphView::GraphView(QWidget *parent) : QGraphicsView(parent), mGraph(NULL), mModel(NULL), mDirty(false), mThicknessModifierId(-1), mStatusId(IFragmentConf::fieldId("status")) {
 	/* Create and set scene + attributes */
 	QGraphicsScene *scene = new QGraphicsScene(this);
 	scene->setBackgroundBrush(QBrush(QColor("#4f4f4f"), Qt::SolidPattern));
@@ -55,6 +55,7 @@ void GraphView::setModel(IMatchModel *model) {
 		mModel = model;
 
 		connect(mModel, SIGNAL(modelChanged()), this, SLOT(modelChanged()));
+		connect(mModel, SIGNAL(rangeReady(int, int)), this, SLOT(matchesReady()));
 
 		modelChanged();
 	}
@@ -78,6 +79,12 @@ void GraphView::modelChanged() {
 	}
 }
 
+void GraphView::matchesReady() {
+	if (isVisible()) {
+		generate();
+	}
+}
+
 void GraphView::wheelEvent(QWheelEvent *event) {
     scaleView(pow((double)2, -event->delta() / (240.0 * 2)));
 }
@@ -98,12 +105,15 @@ void GraphView::generate() {
 
 	if (mModel->size() <= 0) return;
 
+	// don't block the UI on a slow database, matchesReady() generates the graph once the matches are there
+	if (!mModel->requestRangeAsync(0, qMin(mModel->size(), MAXNODES))) return;
+
 	qDebug() << "GraphView::generate: adding nodes";
 
-	mModel->prefetchHint(0, qMin(mModel->size(), MAXNODES));
 	mModel->preloadMatchData(false);
 
 	mThicknessModifierAttribute = "error";
+	mThicknessModifierId = IFragmentConf::fieldId(mThicknessModifierAttribute);
 	mMinThicknessModifier = std::numeric_limits<double>::max();
 	mMaxThicknessModifier = std::numeric_limits<double>::min();;
 
@@ -112,7 +122,7 @@ void GraphView::generate() {
 
 		//IMatchModel status = getInt("status", IMatchModel::UNKNOWN);
 
-		double thicknessModifier = conf.getDouble(mThicknessModifierAttribute, 0.0);
+		double thicknessModifier = conf.getDouble(mThicknessModifierId, 0.0);
 		mMinThicknessModifier = qMin(mMinThicknessModifier, thicknessModifier);
 		mMaxThicknessModifier = qMax(mMaxThicknessModifier, thicknessModifier);
 
@@ -167,10 +177,10 @@ void GraphView::draw() {
 			int thickness = 2;
 
 			// TODO: set thickness based on probability/error/...
-			double thicknessModifier = conf->getDouble(mThicknessModifierAttribute, 0.0);
+			double thicknessModifier = conf->getDouble(mThicknessModifierId, 0.0);
 			double percentage = (thicknessModifier - mMinThicknessModifier) / (mMaxThicknessModifier - mMinThicknessModifier);
 
-			switch (conf->getInt("status", IMatchModel::UNKNOWN)) {
+			switch (conf->getInt(mStatusId, IMatchModel::UNKNOWN)) {
 				case IMatchModel::UNKNOWN: c = QColor(100, 100, 100, 100); break; // unknown
 				case IMatchModel::YES: { c = Qt::green; thickness = 15; } break; // correct
 				case IMatchModel::MAYBE: { c = QColor(255, 128, 0); thickness = 10; } break; // maybe
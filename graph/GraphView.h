@@ -29,6 +29,7 @@ class GraphView : public QGraphicsView {
 
 	public slots:
 		void modelChanged();
+		void matchesReady();
 
 	protected:
 		void wheelEvent(QWheelEvent *event);
@@ -54,6 +55,8 @@ class GraphView : public QGraphicsView {
 		bool mDirty;
 
 		QString mThicknessModifierAttribute;
+		int mThicknessModifierId; // IFragmentConf::fieldId() of mThicknessModifierAttribute
+		const int mStatusId;
 		double mMinThicknessModifier, mMaxThicknessModifier;
 
 	private:
@@ -49,6 +49,10 @@ class IMatchModel : public QObject {
 		// performance switch, doesn't affect functionality
 		virtual void prefetchHint(int start, int end) = 0; // some model types may completely ignore this
 
+		// also a prefetchHint(), returns true if get() can be called for the range without waiting on the database
+		// otherwise the matches are fetched in the background and rangeReady() is emitted when they're there
+		virtual bool requestRangeAsync(int start, int end) = 0;
+
 		// performance switch, doesn't affect functionality
 		// some model types may completely ignore this, if no fields to preload are specified the preload list won't be updated (i.e.: the list from the last call will be used)
 		// temporarily disable preloading like this: preloadMatchData(false); ... get matches; preloadMatchData(true); <--- the same preload fields will be reinstated
@@ -102,6 +106,7 @@ class IMatchModel : public QObject {
 		void modelRefreshed(); // doesn't change the references, but signals that the metadata has been updated. All references are still valid, you can choose to ignore this
 		void modelChanged(); // the entire model could have changed, all old references are no longer valid
 		void orderChanged(); // the amount of matches hasn't changed, nor their values, but the order has changed, all references are no longer valid
+		void rangeReady(int start, int end); // the range asked for with requestRangeAsync() can be read without blocking now
 };
 
 #endif /* IMATCHMODEL_H_ */
@@ -28,7 +28,18 @@ MatchModel::MatchModel(SQLDatabase *db, int refreshInterval, QObject *parent)
 	  mDirty(false),
 	  mPreload(false),
 	  mRefreshTimer(new QTimer(this)),
-	  mBaseRefreshInterval(refreshInterval) {
+	  mBaseRefreshInterval(refreshInterval),
+	  mEstimateCounts(false),
+	  mCountWatcher(new QFutureWatcher<int>(this)),
+	  mPrefetchDepth(1),
+	  mPageCacheSize(8),
+	  mRangeWatcher(new QFutureWatcher<QList<SQLFragmentConf> >(this)),
+	  mRangeBegin(-1),
+	  mRangeStart(0),
+	  mRangeEnd(0) {
+	connect(mCountWatcher, SIGNAL(finished()), this, SLOT(exactCountReady()));
+	connect(mRangeWatcher, SIGNAL(finished()), this, SLOT(rangeFetched()));
+
 	setDatabase(db);
 
 	if (refreshInterval > 0) {
@@ -52,13 +63,17 @@ MatchModel::MatchModel(SQLDatabase *db, int refreshInterval, QObject *parent)
 }
 
 MatchModel::~MatchModel() {
-
+	cancelPrefetch();
 }
 
 void MatchModel::setDatabase(SQLDatabase *db) {
 	if (mDb != db) {
 		if (mDb) disconnect(mDb, 0, this, 0);
 
+		// the windows of the old database are of no use anymore
+		cancelPrefetch();
+		mCountWatcher->cancel();
+
 		mPar = ModelParameters(db);
 		mDb = db;
 
@@ -71,7 +86,8 @@ void MatchModel::setDatabase(SQLDatabase *db) {
 			}
 			else {
 				// can't hurt
-				mDb->addMetaMatchField("num_duplicates", "SELECT duplicate AS match_id, COUNT(duplicate) AS num_duplicates FROM duplicate GROUP BY duplicate");
+				mDb->addMetaMatchField(SQLDatabase::NUM_DUPLICATES_FIELD, SQLDatabase::NUM_DUPLICATES_QUERY);
+				mDb->materializeMetaAttributes();
 			}
 		}
 		else {
@@ -91,6 +107,55 @@ void MatchModel::prefetchHint(int start, int end) {
 	//qDebug() << "Asked for prefetch of" << start << "to" << end << "(windowsize = " << mWindowSize << "and offset =" << mWindowOffset << ")";
 }
 
+bool MatchModel::requestRangeAsync(int start, int end) {
+	if (!mDb || !mDb->isOpen() || !isValidIndex(start)) return true;
+
+	prefetchHint(start, end);
+
+	// already loaded
+	if (!mMatches.isEmpty() && start >= mWindowBegin && end <= mWindowEnd) return true;
+
+	// waiting would happen in get() anyway
+	if (!mDb->canCloneConnection()) return true;
+
+	const int windowBegin = ((start - mNextWindowOffset) / mWindowSize) * mWindowSize + mNextWindowOffset;
+
+	if (hasPage(windowBegin)) return true;
+
+	QHash<int, Prefetch>::iterator i = mPrefetches.find(windowBegin);
+
+	// a prefetch from before the database changed might have the wrong values or even the wrong matches
+	if (i != mPrefetches.end() && i.value().modificationCount != mDb->modificationCount()) {
+		i.value().future.cancel();
+		mPrefetches.erase(i);
+
+		i = mPrefetches.end();
+	}
+
+	if (i == mPrefetches.end()) {
+		SQLQueryParameters parameters((mPreload) ? mPreloadFields : QStringList(), mPar.sortField, mPar.sortOrder, mPar.filter);
+		if (!anchorToPage(parameters, windowBegin)) parameters.moveToAbsoluteWindow(windowBegin, mWindowSize);
+
+		i = mPrefetches.insert(windowBegin, Prefetch(mDb->getMatchesAsync(parameters), mDb->modificationCount()));
+	}
+
+	if (i.value().future.isFinished()) return true;
+
+	mRangeBegin = windowBegin;
+	mRangeStart = start;
+	mRangeEnd = end;
+	mRangeWatcher->setFuture(i.value().future);
+
+	return false;
+}
+
+void MatchModel::rangeFetched() {
+	// cancelled because the parameters changed
+	if (mRangeWatcher->isCanceled()) return;
+
+	emit rangeReady(mRangeStart, mRangeEnd);
+}
+
 void MatchModel::preloadMatchData(bool preload, const QStringList& fields) {
 	mPreload = preload;
 
@@ -106,6 +171,8 @@ void MatchModel::preloadMatchData(bool preload, const QStringList& fields) {
 void MatchModel::setWindowSize(int size) {
 	assert(size > 0);
 
+	if (size != mWindowSize) cancelPrefetch();
+
 	mWindowSize = size;
 }
 
@@ -121,9 +188,26 @@ bool MatchModel::requestWindow(int windowIndex) {
 
 	//qDebug("(1) Requested new window [old: %d, %d] [new: %d, %d], size: %d | offset = %d", mWindowBegin, mWindowEnd, windowIndex * mWindowSize + mWindowOffset, mWindowEnd, mWindowSize, mWindowOffset);
 
+	// the window we're leaving might be wanted again soon
+	storeCurrentPage();
+
 	mWindowBegin = windowIndex * mWindowSize + mNextWindowOffset;
 	mWindowOffset = mNextWindowOffset;
 
+	bool cached = findPage(mWindowBegin, mMatches);
+
+	if (cached || takePrefetched(mWindowBegin, mMatches)) {
+		qDebug() << "MatchModel::requestWindow: window starting at" << mWindowBegin << "was" << (cached ? "cached" : "prefetched");
+
+		mLoadedWindowBegin = mWindowBegin;
+		mWindowEnd = mWindowBegin + mWindowSize - 1;
+
+		beginPage();
+		schedulePrefetch();
+
+		return true;
+	}
+
 	// gets overriden in populateModel, why bother?
 	//mWindowEnd = (windowIndex + 1) * mWindowSize;
 
@@ -251,6 +335,10 @@ inline void MatchModel::neighbours(const thera::SQLFragmentConf& match, Neighbou
 
 			MatchConflictChecker checker(match, list);
 
+			cancelPrefetch();
+			storeCurrentPage();
+			mCurrentPage.key.clear();
+
 			mMatches = checker.getConflicting();
 			mRealSize = mMatches.size();
 			mWindowBegin = 0;
@@ -269,6 +357,10 @@ inline void MatchModel::neighbours(const thera::SQLFragmentConf& match, Neighbou
 
 			MatchConflictChecker checker(match, list);
 
+			cancelPrefetch();
+			storeCurrentPage();
+			mCurrentPage.key.clear();
+
 			//mMatches = checker.getNonconflicting();
 			mMatches = checker.getProgressiveNonconflicting();
 			mRealSize = mMatches.size();
@@ -406,7 +498,7 @@ QString MatchModel::getFilter() const {
 bool MatchModel::setDuplicates(QList<int> duplicatelist, int master, DuplicateMode mode) {
 	// will create the num_duplicates view if it doesn't exist yet
 	// TODO: if we switch to a remote database, we need to save on every query, so try to eliminate this one as it will in general be redundant
-	//mDb->addMetaMatchField("num_duplicates", "SELECT duplicate AS match_id, COUNT(duplicate) AS num_duplicates FROM duplicate GROUP BY duplicate");
+	//mDb->addMetaMatchField(SQLDatabase::NUM_DUPLICATES_FIELD, SQLDatabase::NUM_DUPLICATES_QUERY);
 
 	if (!isValidIndex(master)) {
 		qDebug() << "MatchModel::setDuplicates: master wasn't valid";
@@ -429,8 +521,10 @@ bool MatchModel::setDuplicates(QList<int> duplicatelist, int master, DuplicateMo
 		default: qDebug() << "MatchModel::setDuplicates: unknown duplicate mode";
 	}
 
-	// point all the matches referenced in the duplicates argument to the master
+	// point all the matches referenced in the duplicates argument to the master, in one go after the old groups were converted
 	qDebug() << "MatchModel::setDuplicates: NEW GROUP setting duplicate =" << conf.index() << "on" << duplicates.size() << "matches" << duplicates;
+	QHash<int, QVariant> values;
+
 	foreach (int modelId, duplicates) {
 		if (!isValidIndex(modelId)) { qDebug() << "MatchModel::setDuplicates: model id wasn't valid"; continue; }
 
@@ -447,17 +541,24 @@ bool MatchModel::setDuplicates(QList<int> duplicatelist, int master, DuplicateMo
 		}
 
 		// this is likely unnecessary after convertGroupToMaster with ABSORB, but not harmful
-		duplicate.setMetaData("duplicate", conf.index());
+		values.insert(duplicate.index(), conf.index());
 	}
 
-	conf.setMetaData("duplicate", 0);
+	values.insert(conf.index(), 0);
+
+	if (!mDb->updateAttribute("duplicate", values)) {
+		qDebug() << "MatchModel::setDuplicates: couldn't update the duplicates";
+	}
 
 	foreach (const SQLFragmentConf& c, mMatches) {
 		c.clearCache("duplicate");
 		c.clearCache("num_duplicates");
 	}
 
+	// the prefetched windows have stale copies of duplicate and num_duplicates
+	cancelPrefetch();
 	refresh(true);
+	schedulePrefetch();
 
 	return true;
 }
@@ -484,25 +585,19 @@ bool MatchModel::setMaster(int master) {
 		convertGroupToMaster(duplicateGroup, conf.index());
 
 		// num_duplicates will be stale after this
-		// someday, all of this will be automated, it will be a better world
-		// an idea for a start:
-		// all caches are managed by the SQLDatabase, the SQLFragmentConf request them when necessary like this:
-		// 		mDb->getCache(...)
-		// the db could scan all queries and invalidate caches on an automatic basis
-		//
-		// almost scratch that, even better: mDb->getMetaData(...), which already exists, could just fetch from a cache, right?
-		// But... how will the database know when to delete a cache? It can't keep smart pointers to all of its SQLFragmentConf's
-		// ---> true, but the caching system is supposed to be transparant, so it's not too bad if the db starts dropping caches as if they were smoldering
-		// 		when it has reached a certain limit. You know, LRU and stuff. Man... it sure feels like we're repeating stuff over here!
+		// the database's shared attribute cache (SQLAttributeCache, bounded with LRU eviction) already dropped its copies
+		// when the values were set, but every SQLFragmentConf still holds its own, so those have to go by hand
 		foreach (const SQLFragmentConf& c, mMatches) {
 			c.clearCache("duplicate");
 			c.clearCache("num_duplicates");
 		}
 
-		// in fact, for now it's just cheaper to just refresh EVERYTHING in one go, because clearing the cache for num_duplicates will cause 20 small queries
-		// 1 big one usually performs better, unless it's REALLY big (we hope not)
+		// the misses for num_duplicates would be resolved for the whole window in one query per field (see SQLDatabase::fetchGroupValue),
+		// but refreshing EVERYTHING in one go also picks up the other changes, and 1 big query usually performs well enough
 		// TODO: we could make a refreh that doesn't emit a signal, and rely on the VIEW to reload itself when we return true
+		cancelPrefetch();
 		refresh();
+		schedulePrefetch();
 	}
 
 	return true;
@@ -511,49 +606,63 @@ bool MatchModel::setMaster(int master) {
 bool MatchModel::resetDuplicates(QList<int> duplicates) {
 	// point all the matches referenced in the duplicates argument to the master
 	qDebug() << "MatchModel::resetDuplicates: resetting" << duplicates.size() << "matches:" << duplicates;
+	QHash<int, QVariant> values;
+	QList<int> groups;
+
 	foreach (int modelId, duplicates) {
 		if (!isValidIndex(modelId)) { qDebug() << "MatchModel::resetDuplicates: model id wasn't valid"; continue; }
 
 		IFragmentConf& duplicate = get(modelId);
 		int duplicateGroup = duplicate.getInt("duplicate", 0);
 
-		duplicate.setMetaData("duplicate", 0);
+		values.insert(duplicate.index(), 0);
 
 		if (duplicateGroup != 0) {
 			// this means the duplicate was the master of a group, in which case we'll have to convert its group as well
-			convertGroupToMaster(duplicate.index(), 0);
+			groups << duplicate.index();
 		}
 	}
 
+	if (!mDb->updateAttribute("duplicate", values)) {
+		qDebug() << "MatchModel::resetDuplicates: couldn't reset the duplicates";
+	}
+
+	foreach (int group, groups) {
+		convertGroupToMaster(group, 0);
+	}
+
 	foreach (const SQLFragmentConf& c, mMatches) {
 		c.clearCache("duplicate");
 		c.clearCache("num_duplicates");
 	}
 
+	// the prefetched windows have stale copies of duplicate and num_duplicates
+	cancelPrefetch();
 	refresh(true);
+	schedulePrefetch();
 
 	return true;
 }
 
 void MatchModel::convertGroupToMaster(int groupMatchId, int masterMatchId) {
-	// first part of filter = all matches who have the same duplicate as the new master
-	// second part of filter = the current master
-	SQLFilter filter(mDb);
-	filter.setFilter("filter", QString("duplicate = %1 OR matches.match_id = %1").arg(groupMatchId));
-
-	SQLQueryParameters parameters = SQLQueryParameters(QStringList(), QString(), Qt::AscendingOrder, filter);
-	QList<SQLFragmentConf> list = mDb->getMatches(parameters);
-	//QList<SQLFragmentConf> list = mDb->getMatches(QString(), Qt::AscendingOrder, filter);
-
-	foreach (const SQLFragmentConf& c, list) {
-		if (c.index() == masterMatchId) {
-			qDebug() << "MatchModel::convertGroupToMaster: making pair" << c.index() << "the master of group" << masterMatchId;
-			c.setMetaData("duplicate", 0);
-		}
-		else {
-			qDebug() << "MatchModel::convertGroupToMaster: making pair" << c.index() << "a duplicate of" << masterMatchId;
-			c.setMetaData("duplicate", masterMatchId);
-		}
+	// the group = all matches who have the same duplicate as the new master + the current master
+	// they're updated in the database directly, without fetching them first
+	const QString group = QString("duplicate = %1 OR matches.match_id = %1").arg(groupMatchId);
+
+	qDebug() << "MatchModel::convertGroupToMaster: making the pairs of group" << groupMatchId << "duplicates of" << masterMatchId;
+
+	SQLFilter duplicates(mDb);
+	duplicates.setFilter("filter", QString("(%1) AND matches.match_id <> %2").arg(group).arg(masterMatchId));
+
+	mDb->updateAttribute("duplicate", masterMatchId, duplicates);
+
+	if (masterMatchId != 0) {
+		qDebug() << "MatchModel::convertGroupToMaster: making pair" << masterMatchId << "the master of group" << groupMatchId;
+
+		SQLFilter master(mDb);
+		master.setFilter("filter", QString("matches.match_id = %1 AND (%2)").arg(masterMatchId).arg(group));
+
+		mDb->updateAttribute("duplicate", 0, master);
 	}
 }
 
@@ -676,19 +785,311 @@ bool MatchModel::populateModel() {
 
 	qDebug() << "MatchModel::populateModel: Done repopulating model," << mLastQueryMsec << "milliseconds";
 
+	beginPage();
+	schedulePrefetch();
+
 	return true;
 }
 
+void MatchModel::setPrefetchDepth(int windows) {
+	mPrefetchDepth = qMax(0, windows);
+
+	if (mPrefetchDepth == 0) cancelPrefetch();
+	else schedulePrefetch();
+}
+
+int MatchModel::prefetchDepth() const {
+	return mPrefetchDepth;
+}
+
+void MatchModel::schedulePrefetch() {
+	if (mPrefetchDepth <= 0 || !mDb || !mDb->isOpen() || !mDb->canCloneConnection()) return;
+
+	// windows that aren't aligned to the current one, or the whole resultset (neighbour modes), can't be paged from
+	if (mMatches.isEmpty() || mWindowSize <= 0 || mWindowEnd != mWindowBegin + mWindowSize - 1) return;
+
+	// only keep what is in reach of the current window, and the window requestRangeAsync() is waiting for
+	QSet<int> wanted;
+	for (int d = 1; d <= mPrefetchDepth; ++d) {
+		wanted << mWindowBegin + d * mWindowSize << mWindowBegin - d * mWindowSize;
+	}
+
+	if (mRangeWatcher->isRunning()) wanted << mRangeBegin;
+
+	// the stale ones are started over below, except the one requestRangeAsync() waits for, takePrefetched() drops that one
+	QMutableHashIterator<int, Prefetch> i(mPrefetches);
+	while (i.hasNext()) {
+		i.next();
+
+		const bool stale = i.value().modificationCount != mDb->modificationCount();
+		const bool waitedFor = mRangeWatcher->isRunning() && i.key() == mRangeBegin;
+
+		if (!wanted.contains(i.key()) || (stale && !waitedFor)) {
+			i.value().future.cancel();
+			i.remove();
+		}
+	}
+
+	const QStringList preloadFields = (mPreload) ? mPreloadFields : QStringList();
+	const bool fullWindow = mMatches.size() == mWindowSize;
+
+	for (int d = 1; d <= mPrefetchDepth; ++d) {
+		// relative to the edges of the current window (keyset pagination), skipping the windows in between
+		const int offset = (d - 1) * mWindowSize;
+
+		const int next = mWindowBegin + d * mWindowSize;
+		if (fullWindow && next < mRealSize && !mPrefetches.contains(next) && !hasPage(next)) {
+			SQLQueryParameters parameters(preloadFields, mPar.sortField, mPar.sortOrder, mPar.filter);
+			parameters.moveToRelativeWindow(mMatches.last(), false, true, offset, mWindowSize);
+
+			mPrefetches.insert(next, Prefetch(mDb->getMatchesAsync(parameters), mDb->modificationCount()));
+		}
+
+		const int previous = mWindowBegin - d * mWindowSize;
+		if (previous >= 0 && !mPrefetches.contains(previous) && !hasPage(previous)) {
+			SQLQueryParameters parameters(preloadFields, mPar.sortField, mPar.sortOrder, mPar.filter);
+			parameters.moveToRelativeWindow(mMatches.first(), false, false, offset, mWindowSize);
+
+			mPrefetches.insert(previous, Prefetch(mDb->getMatchesAsync(parameters), mDb->modificationCount()));
+		}
+	}
+}
+
+void MatchModel::cancelPrefetch() {
+	// the queries that are already running can't be interrupted, but their results will be dropped
+	foreach (Prefetch prefetch, mPrefetches) {
+		prefetch.future.cancel();
+	}
+
+	mPrefetches.clear();
+}
+
+bool MatchModel::takePrefetched(int windowBegin, QList<thera::SQLFragmentConf>& list) {
+	QHash<int, Prefetch>::iterator i = mPrefetches.find(windowBegin);
+
+	if (i == mPrefetches.end()) return false;
+
+	WindowFuture future = i.value().future;
+	const bool stale = i.value().modificationCount != mDb->modificationCount();
+	mPrefetches.erase(i);
+
+	// the database changed after it was started, like the pages in the page cache
+	if (stale) {
+		future.cancel();
+
+		return false;
+	}
+
+	// don't block the GUI thread on a query that is still underway, populateModel() fetches the window itself
+	if (!future.isFinished()) {
+		future.cancel();
+
+		return false;
+	}
+
+	if (future.isCanceled() || future.resultCount() == 0) return false;
+
+	list = future.result();
+
+	return !list.isEmpty();
+}
+
+void MatchModel::setPageCacheSize(int windows) {
+	mPageCacheSize = qMax(0, windows);
+
+	while (mPages.size() > mPageCacheSize) mPages.removeLast();
+}
+
+int MatchModel::pageCacheSize() const {
+	return mPageCacheSize;
+}
+
+QString MatchModel::pageKey() const {
+	return QString("%1 | preload = %2 | window size = %3")
+		.arg(mPar.toString())
+		.arg((mPreload) ? mPreloadFields.join(", ") : QString())
+		.arg(mWindowSize);
+}
+
+void MatchModel::beginPage() {
+	mCurrentPage.key = (mDb) ? pageKey() : QString();
+	mCurrentPage.sortField = mPar.sortField;
+	mCurrentPage.windowBegin = mLoadedWindowBegin;
+	mCurrentPage.modificationCount = (mDb) ? mDb->modificationCount() : 0;
+}
+
+void MatchModel::storeCurrentPage() {
+	if (mPageCacheSize <= 0 || !mDb || mCurrentPage.key.isEmpty() || mMatches.isEmpty()) return;
+
+	// the matches changed since the window was fetched, it can't be trusted anymore (and neither can the other pages)
+	if (mCurrentPage.modificationCount != mDb->modificationCount()) {
+		clearPageCache();
+
+		return;
+	}
+
+	Page page = mCurrentPage;
+	page.matches = mMatches;
+
+	const SQLFragmentConf& first = mMatches.first();
+	const SQLFragmentConf& last = mMatches.last();
+
+	page.firstMatchId = first.index();
+	page.lastMatchId = last.index();
+	page.firstSortValue = (!page.sortField.isEmpty()) ? first.getDouble(page.sortField, 0.0) : 0.0;
+	page.lastSortValue = (!page.sortField.isEmpty()) ? last.getDouble(page.sortField, 0.0) : 0.0;
+
+	for (int i = 0; i < mPages.size(); ++i) {
+		if (mPages.at(i).windowBegin == page.windowBegin && mPages.at(i).key == page.key) {
+			mPages.removeAt(i);
+
+			break;
+		}
+	}
+
+	mPages.prepend(page);
+
+	while (mPages.size() > mPageCacheSize) mPages.removeLast();
+}
+
+bool MatchModel::findPage(int windowBegin, QList<thera::SQLFragmentConf>& list) {
+	if (!mDb || mPages.isEmpty()) return false;
+
+	const QString key = pageKey();
+
+	for (int i = 0; i < mPages.size(); ++i) {
+		const Page& page = mPages.at(i);
+
+		if (page.windowBegin == windowBegin && page.key == key) {
+			if (page.modificationCount != mDb->modificationCount()) {
+				clearPageCache();
+
+				return false;
+			}
+
+			list = page.matches;
+
+			// most recently used goes in front
+			if (i != 0) mPages.move(i, 0);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool MatchModel::hasPage(int windowBegin) const {
+	if (!mDb || mPages.isEmpty()) return false;
+
+	const QString key = pageKey();
+
+	foreach (const Page& page, mPages) {
+		if (page.windowBegin == windowBegin && page.key == key && page.modificationCount == mDb->modificationCount()) return true;
+	}
+
+	return false;
+}
+
+bool MatchModel::anchorToPage(SQLQueryParameters& parameters, int windowBegin) const {
+	if (!mDb || mPages.isEmpty()) return false;
+
+	const QString key = pageKey();
+	const Page *nearest = NULL;
+	int nearestGap = 0;
+	bool forward = true;
+
+	foreach (const Page& page, mPages) {
+		if (page.key != key || page.modificationCount != mDb->modificationCount()) continue;
+
+		// an incomplete page is the last one, there's nothing after it to anchor to
+		if (page.matches.size() == mWindowSize) {
+			const int gap = windowBegin - (page.windowBegin + mWindowSize);
+
+			if (gap >= 0 && (!nearest || gap < nearestGap)) {
+				nearest = &page;
+				nearestGap = gap;
+				forward = true;
+			}
+		}
+
+		const int gap = page.windowBegin - (windowBegin + mWindowSize);
+
+		if (gap >= 0 && (!nearest || gap < nearestGap)) {
+			nearest = &page;
+			nearestGap = gap;
+			forward = false;
+		}
+	}
+
+	if (!nearest) return false;
+
+	qDebug() << "MatchModel::anchorToPage: fetching window" << windowBegin << (forward ? "after" : "before") << "cached page" << nearest->windowBegin << "with a gap of" << nearestGap;
+
+	if (forward) parameters.moveToRelativeWindow(nearest->lastMatchId, nearest->lastSortValue, false, true, nearestGap, mWindowSize);
+	else parameters.moveToRelativeWindow(nearest->firstMatchId, nearest->firstSortValue, false, false, nearestGap, mWindowSize);
+
+	return true;
+}
+
+void MatchModel::clearPageCache() {
+	mPages.clear();
+}
+
 void MatchModel::requestRealSize() {
 	QElapsedTimer timer;
 	timer.start();
 
-	mRealSize = mDb->getNumberOfMatches(mPar.filter);
+	if (mEstimateCounts && mDb->canCloneConnection()) {
+		bool exact = false;
+
+		mRealSize = mDb->estimateNumberOfMatches(mPar.filter, &exact);
+
+		if (!exact) {
+			qDebug() << "MatchModel::requestRealSize: estimated" << mRealSize << "matches, counting in the background";
+
+			// a count for the previous filter is superseded by this one
+			mCountingFilter = mPar.filter;
+			mCountWatcher->setFuture(mDb->getNumberOfMatchesAsync(mPar.filter, QString("MatchModel::count %1").arg(quintptr(this))));
+		}
+	}
+	else {
+		mRealSize = mDb->getNumberOfMatches(mPar.filter);
+	}
 
 	qDebug() << "MatchModel::requestRealSize: Get # of matches," << timer.elapsed() << "milliseconds [result" << mRealSize << "matches]";
 }
 
+void MatchModel::setEstimatedCounts(bool estimate) {
+	mEstimateCounts = estimate;
+}
+
+bool MatchModel::estimatedCounts() const {
+	return mEstimateCounts;
+}
+
+void MatchModel::exactCountReady() {
+	// the parameters changed while counting
+	if (!mDb || mCountingFilter != mPar.filter || mCountWatcher->isCanceled() || mCountWatcher->future().resultCount() == 0) return;
+
+	const int count = mCountWatcher->result();
+
+	qDebug() << "MatchModel::exactCountReady: the exact count is" << count << "matches, the estimate was" << mRealSize;
+
+	if (count != mRealSize) {
+		mRealSize = count;
+
+		emit modelChanged();
+	}
+}
+
 void MatchModel::resetWindow() {
+	cancelPrefetch();
+
+	// with the parameters it was fetched with, which might have just changed
+	storeCurrentPage();
+	mCurrentPage.key.clear();
+
 	mWindowBegin = 0;
 	mWindowEnd = -1;
 	//mWindowEnd = mWindowBegin + mWindowSize - 1;
@@ -804,6 +1205,7 @@ void MatchModel::databaseModified() {
 	resetSort();
 	resetFilter();
 	resetWindow();
+	clearPageCache();
 
 	if (mDb && mDb->isOpen()) {
 		requestRealSize();
@@ -847,7 +1249,8 @@ inline const QList<thera::SQLFragmentConf> MatchModel::fetchCurrentMatches() {
 		if (mWindowBegin < mLoadedWindowBegin && requestedWindowEnd > loadedWindowEnd) {
 			qDebug("MatchModel::fetchCurrentMatches: [PAGINATION -> STANDARD] fail, older window strictly smaller [%d,%d] than new window [%d,%d], switching to standard query", mLoadedWindowBegin, loadedWindowEnd, mWindowBegin, requestedWindowEnd);
 
-			parameters.moveToAbsoluteWindow(mWindowBegin, mWindowSize);
+			// a cached page nearby still beats an OFFSET from the very start
+			if (!anchorToPage(parameters, mWindowBegin)) parameters.moveToAbsoluteWindow(mWindowBegin, mWindowSize);
 
 			//list = (mPreload) ?
 			//	mDb->getPreloadedMatches(mPreloadFields, mPar.sortField, mPar.sortOrder, mPar.filter, mWindowBegin, mWindowSize) :
@@ -934,7 +1337,7 @@ inline const QList<thera::SQLFragmentConf> MatchModel::fetchCurrentMatches() {
 	else {
 		qDebug("MatchModel::fetchCurrentMatches: [NO] doing it the standard way because [%d,%d] to window [%d,%d]", mLoadedWindowBegin, loadedWindowEnd, mWindowBegin, requestedWindowEnd);
 
-		parameters.moveToAbsoluteWindow(mWindowBegin, mWindowSize);
+		if (!anchorToPage(parameters, mWindowBegin)) parameters.moveToAbsoluteWindow(mWindowBegin, mWindowSize);
 
 		/*
 		list = (mPreload) ?
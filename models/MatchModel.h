@@ -6,6 +6,9 @@
 #include <QSet>
 #include <QList>
 #include <QRegExp>
+#include <QHash>
+#include <QFuture>
+#include <QFutureWatcher>
 
 #include "SQLFragmentConf.h"
 #include "InvalidFragmentConf.h"
@@ -26,8 +29,23 @@ class MatchModel : public IMatchModel {
 
 		void setDatabase(SQLDatabase *db);
 
+		// how many windows before and after the current one are fetched in the background, 0 disables prefetching
+		// it only happens for databases that can be read from another thread (see SQLDatabase::canCloneConnection())
+		void setPrefetchDepth(int windows);
+		int prefetchDepth() const;
+
+		// how many of the windows that were left are kept (for any parameters), so going back to one costs no queries
+		void setPageCacheSize(int windows);
+		int pageCacheSize() const;
+
+		// if enabled, an estimate of the size is used right away when the exact count isn't known yet, the exact count is
+		// done in the background and modelChanged() is sent when it arrives (needs SQLDatabase::canCloneConnection())
+		void setEstimatedCounts(bool estimate);
+		bool estimatedCounts() const;
+
 	public:
 		virtual void prefetchHint(int start, int end);
+		virtual bool requestRangeAsync(int start, int end);
 		virtual void preloadMatchData(bool preload, const QStringList& fields = QStringList()) ;
 
 		virtual void setWindowSize(int size);
@@ -84,12 +102,34 @@ class MatchModel : public IMatchModel {
 
 		void convertGroupToMaster(int groupMatchId, int masterMatchId);
 
+		// starts fetching the windows around the current one that aren't prefetched yet, drops the ones that are out of reach
+		void schedulePrefetch();
+		// discards all prefetched windows, the ones still being fetched will be thrown away when they arrive
+		void cancelPrefetch();
+		// waits if the window is still being fetched, returns false if it wasn't prefetched
+		bool takePrefetched(int windowBegin, QList<thera::SQLFragmentConf>& list);
+
+		// identifies everything that determines the contents of a window, except for where it begins
+		QString pageKey() const;
+		// remembers the parameters of the window that was just loaded, call after mMatches and mLoadedWindowBegin are set
+		void beginPage();
+		// puts the current window in the page cache, if it's still up to date
+		void storeCurrentPage();
+		bool findPage(int windowBegin, QList<thera::SQLFragmentConf>& list);
+		bool hasPage(int windowBegin) const;
+		// points parameters at the window starting at windowBegin relative to the nearest cached page, returns false if there is none
+		bool anchorToPage(SQLQueryParameters& parameters, int windowBegin) const;
+		void clearPageCache();
+
 	private slots:
 		//void matchCountChanged();
 		void databaseModified();
 
 		void refresh(bool forceReloadOnConflict = false);
 
+		void exactCountReady();
+		void rangeFetched();
+
 	private:
 		SQLDatabase *mDb;
 
@@ -114,6 +154,44 @@ class MatchModel : public IMatchModel {
 		int mBaseRefreshInterval;
 
 		qint64 mLastQueryMsec;
+
+		bool mEstimateCounts;
+		QFutureWatcher<int> *mCountWatcher;
+		SQLFilter mCountingFilter; // the filter the background count is for
+
+		int mPrefetchDepth;
+
+		struct Page {
+			QString key;
+			QString sortField;
+			int windowBegin;
+			int modificationCount; // SQLDatabase::modificationCount() when the window was fetched
+			QList<thera::SQLFragmentConf> matches;
+
+			// the pagination anchors, so the adjacent windows can be fetched relative to this one
+			int firstMatchId, lastMatchId;
+			double firstSortValue, lastSortValue;
+		};
+
+		Page mCurrentPage; // matches is left empty, the key is empty if the current window isn't a regular one
+		QList<Page> mPages; // most recently used first
+		int mPageCacheSize;
+
+		typedef QFuture<QList<thera::SQLFragmentConf> > WindowFuture;
+
+		struct Prefetch {
+			Prefetch() : modificationCount(0) { }
+			Prefetch(const WindowFuture& _future, int _modificationCount) : future(_future), modificationCount(_modificationCount) { }
+
+			WindowFuture future;
+			int modificationCount; // SQLDatabase::modificationCount() when the prefetch started, it's stale once that changed
+		};
+
+		QHash<int, Prefetch> mPrefetches; // window beginning -> window, finished or still being fetched
+
+		// the window requestRangeAsync() is waiting for
+		QFutureWatcher<QList<thera::SQLFragmentConf> > *mRangeWatcher;
+		int mRangeBegin, mRangeStart, mRangeEnd;
 };
 
 #endif /* MATCHMODEL_H_ */
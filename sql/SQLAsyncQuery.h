@@ -0,0 +1,45 @@
+#ifndef SQLASYNCQUERY_H_
+#define SQLASYNCQUERY_H_
+
+#include <QRunnable>
+#include <QFuture>
+#include <QFutureInterface>
+
+/**
+ * A query that runs on one of the threads of SQLDatabase's query pool, its result is reported through a QFuture.
+ *
+ * Cancelling the future before the query got started means it won't run at all, a query that is already
+ * running can't be interrupted but its result is thrown away (so the future never has a result).
+ */
+template<typename T> class SQLAsyncQuery : public QRunnable {
+	public:
+		SQLAsyncQuery() {
+			mInterface.reportStarted();
+		}
+
+		virtual ~SQLAsyncQuery() { }
+
+	public:
+		QFuture<T> future() {
+			return mInterface.future();
+		}
+
+		virtual void run() {
+			if (!mInterface.isCanceled()) {
+				const T result = execute();
+
+				if (!mInterface.isCanceled()) mInterface.reportResult(result);
+			}
+
+			mInterface.reportFinished();
+		}
+
+	protected:
+		// runs on the pool thread, SQLDatabase::database() gives the connection of that thread
+		virtual T execute() = 0;
+
+	private:
+		QFutureInterface<T> mInterface;
+};
+
+#endif /* SQLASYNCQUERY_H_ */
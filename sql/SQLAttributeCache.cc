@@ -0,0 +1,196 @@
+#include "SQLAttributeCache.h"
+
+#include <QMutexLocker>
+#include <QtDebug>
+
+const int SQLAttributeCache::DEFAULT_CAPACITY = 50000;
+
+SQLAttributeCache::SQLAttributeCache(int capacity)
+	: mHand(0), mCapacity(qMax(1, capacity)), mHits(0), mMisses(0) {
+}
+
+SQLAttributeCache::~SQLAttributeCache() {
+}
+
+inline quint64 SQLAttributeCache::key(int matchId, int fieldId) {
+	return (quint64(quint32(matchId)) << 32) | quint32(fieldId);
+}
+
+bool SQLAttributeCache::lookup(int matchId, int fieldId, QVariant& value) {
+	QMutexLocker locker(&mMutex);
+
+	QHash<quint64, int>::const_iterator i = mIndex.constFind(key(matchId, fieldId));
+
+	if (i == mIndex.constEnd()) {
+		++mMisses;
+
+		return false;
+	}
+
+	Slot& slot = mSlots[i.value()];
+	slot.referenced = true;
+	value = slot.value;
+
+	++mHits;
+
+	return true;
+}
+
+bool SQLAttributeCache::contains(int matchId, int fieldId) const {
+	QMutexLocker locker(&mMutex);
+
+	return mIndex.contains(key(matchId, fieldId));
+}
+
+void SQLAttributeCache::insert(int matchId, int fieldId, const QVariant& value) {
+	QMutexLocker locker(&mMutex);
+
+	const quint64 k = key(matchId, fieldId);
+	QHash<quint64, int>::const_iterator i = mIndex.constFind(k);
+
+	if (i != mIndex.constEnd()) {
+		Slot& slot = mSlots[i.value()];
+		slot.value = value;
+		slot.referenced = true;
+
+		return;
+	}
+
+	const int s = freeSlot();
+	Slot& slot = mSlots[s];
+
+	slot.key = k;
+	slot.value = value;
+	slot.used = true;
+	// new entries start out unreferenced, so a scan over many matches that are only read once doesn't push out the ones that are read often
+	slot.referenced = false;
+
+	mIndex.insert(k, s);
+}
+
+void SQLAttributeCache::invalidate(int matchId, int fieldId) {
+	QMutexLocker locker(&mMutex);
+
+	QHash<quint64, int>::iterator i = mIndex.find(key(matchId, fieldId));
+
+	if (i != mIndex.end()) {
+		const int s = i.value();
+
+		mIndex.erase(i);
+		release(s);
+	}
+}
+
+void SQLAttributeCache::invalidateField(int fieldId) {
+	QMutexLocker locker(&mMutex);
+
+	for (int s = 0; s < mSlots.size(); ++s) {
+		if (mSlots.at(s).used && quint32(mSlots.at(s).key) == quint32(fieldId)) {
+			mIndex.remove(mSlots.at(s).key);
+			release(s);
+		}
+	}
+}
+
+void SQLAttributeCache::clear() {
+	QMutexLocker locker(&mMutex);
+
+	mSlots.clear();
+	mIndex.clear();
+	mFreeSlots.clear();
+	mHand = 0;
+}
+
+void SQLAttributeCache::setCapacity(int capacity) {
+	QMutexLocker locker(&mMutex);
+
+	capacity = qMax(1, capacity);
+
+	if (capacity < mSlots.size()) {
+		qDebug() << "SQLAttributeCache::setCapacity: shrinking from" << mCapacity << "to" << capacity << "entries, clearing the cache";
+
+		mSlots.clear();
+		mIndex.clear();
+		mFreeSlots.clear();
+		mHand = 0;
+	}
+
+	mCapacity = capacity;
+}
+
+int SQLAttributeCache::capacity() const {
+	QMutexLocker locker(&mMutex);
+
+	return mCapacity;
+}
+
+int SQLAttributeCache::size() const {
+	QMutexLocker locker(&mMutex);
+
+	return mIndex.size();
+}
+
+quint64 SQLAttributeCache::hits() const {
+	QMutexLocker locker(&mMutex);
+
+	return mHits;
+}
+
+quint64 SQLAttributeCache::misses() const {
+	QMutexLocker locker(&mMutex);
+
+	return mMisses;
+}
+
+void SQLAttributeCache::resetStatistics() {
+	QMutexLocker locker(&mMutex);
+
+	mHits = 0;
+	mMisses = 0;
+}
+
+int SQLAttributeCache::freeSlot() {
+	if (!mFreeSlots.isEmpty()) {
+		const int s = mFreeSlots.last();
+		mFreeSlots.pop_back();
+
+		return s;
+	}
+
+	if (mSlots.size() < mCapacity) {
+		mSlots.append(Slot());
+
+		return mSlots.size() - 1;
+	}
+
+	// CLOCK: give every referenced entry a second chance, evict the first one that didn't get used since the last sweep
+	// this terminates within two rounds, because the first round clears all the bits
+	forever {
+		Slot& slot = mSlots[mHand];
+		const int s = mHand;
+
+		mHand = (mHand + 1) % mSlots.size();
+
+		if (slot.referenced) {
+			slot.referenced = false;
+		}
+		else {
+			mIndex.remove(slot.key);
+
+			slot.used = false;
+			slot.value = QVariant();
+
+			return s;
+		}
+	}
+}
+
+void SQLAttributeCache::release(int s) {
+	Slot& slot = mSlots[s];
+
+	slot.used = false;
+	slot.referenced = false;
+	slot.value = QVariant();
+
+	mFreeSlots << s;
+}
@@ -0,0 +1,80 @@
+#ifndef SQLATTRIBUTECACHE_H_
+#define SQLATTRIBUTECACHE_H_
+
+#include <QVariant>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+
+/**
+ * A bounded cache of attribute values keyed by (match_id, field id), shared by everything
+ * that reads through one SQLDatabase. When it's full the least recently used entries are
+ * evicted, approximated with the CLOCK algorithm: every entry has a referenced bit which is
+ * set on a hit, and the hand sweeps over the slots clearing bits until it finds one that wasn't.
+ *
+ * An invalid QVariant can be stored to remember that a match doesn't have a value for an attribute.
+ *
+ * All methods are thread-safe.
+ */
+class SQLAttributeCache {
+	public:
+		SQLAttributeCache(int capacity = DEFAULT_CAPACITY);
+		virtual ~SQLAttributeCache();
+
+	public:
+		// returns false if nothing was cached for the pair, which counts as a miss
+		bool lookup(int matchId, int fieldId, QVariant& value);
+		bool contains(int matchId, int fieldId) const; // doesn't count as a hit or miss
+		void insert(int matchId, int fieldId, const QVariant& value);
+
+		void invalidate(int matchId, int fieldId);
+		void invalidateField(int fieldId); // for all matches, this has to scan the entire cache
+		void clear();
+
+		// shrinking the cache clears it
+		void setCapacity(int capacity);
+		int capacity() const;
+		int size() const;
+
+		quint64 hits() const;
+		quint64 misses() const;
+		void resetStatistics();
+
+	public:
+		static const int DEFAULT_CAPACITY;
+
+	private:
+		static quint64 key(int matchId, int fieldId);
+
+		// returns the slot to put a new entry in, evicts if necessary, call with the mutex locked
+		int freeSlot();
+		void release(int slot);
+
+	private:
+		// disabling copy-constructor and copy-assignment
+		SQLAttributeCache(const SQLAttributeCache&);
+		SQLAttributeCache& operator=(const SQLAttributeCache&);
+
+	private:
+		struct Slot {
+			Slot() : key(0), used(false), referenced(false) { }
+
+			quint64 key;
+			QVariant value;
+			bool used;
+			bool referenced;
+		};
+
+		mutable QMutex mMutex;
+
+		QVector<Slot> mSlots;
+		QHash<quint64, int> mIndex; // key -> slot
+		QVector<int> mFreeSlots;
+		int mHand;
+		int mCapacity;
+
+		quint64 mHits;
+		quint64 mMisses;
+};
+
+#endif /* SQLATTRIBUTECACHE_H_ */
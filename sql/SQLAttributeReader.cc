@@ -0,0 +1,85 @@
+#include "SQLAttributeReader.h"
+
+#include <limits>
+
+const int SQLAttributeReader::DEFAULT_CHUNK_SIZE = 10000;
+
+SQLAttributeReader::SQLAttributeReader(const QSqlDatabase& db, const QString& table, const QString& field, int chunkSize, const QString& condition)
+	: mDb(db), mTable(table), mField(field), mChunkSize(qMax(0, chunkSize)), mCondition(condition), mQuery(db) {
+	reset();
+}
+
+SQLAttributeReader::~SQLAttributeReader() {
+}
+
+void SQLAttributeReader::reset() {
+	mQuery.finish();
+
+	mLastMatchId = std::numeric_limits<int>::min();
+	mInChunk = 0;
+	mDone = !isValid();
+	mError = false;
+	mRecordsRead = 0;
+
+	if (!mDone) mDone = !fetch();
+}
+
+bool SQLAttributeReader::next(AttributeRecord& record) {
+	while (!mDone) {
+		if (mQuery.next()) {
+			record.matchId = mQuery.value(0).toInt();
+			record.value = mQuery.value(1);
+
+			mLastMatchId = record.matchId;
+			++mInChunk;
+			++mRecordsRead;
+
+			return true;
+		}
+
+		// a chunk that wasn't full was the last one, without chunks there's only one
+		if (mChunkSize == 0 || mInChunk < mChunkSize || !fetch()) mDone = true;
+	}
+
+	return false;
+}
+
+bool SQLAttributeReader::fetch() {
+	mInChunk = 0;
+
+	mQuery.finish();
+	mQuery.setForwardOnly(true);
+	QStringList where;
+	if (mChunkSize > 0) where << "match_id > ?";
+	if (!mCondition.isEmpty()) where << mCondition;
+
+	QString queryString = QString("SELECT match_id, %1 FROM %2").arg(mField).arg(mTable);
+	if (!where.isEmpty()) queryString += " WHERE (" + where.join(") AND (") + ")";
+	queryString += " ORDER BY match_id";
+	if (mChunkSize > 0) queryString += QString(" LIMIT %1").arg(mChunkSize);
+
+	mQuery.prepare(queryString);
+	if (mChunkSize > 0) mQuery.addBindValue(mLastMatchId);
+
+	if (!mQuery.exec()) {
+		qDebug() << "SQLAttributeReader::fetch: couldn't read" << mField << "from" << mTable << "->" << mQuery.lastError() << "\n\tQUERY =" << mQuery.lastQuery();
+
+		mError = true;
+
+		return false;
+	}
+
+	return true;
+}
+
+bool SQLAttributeReader::isValid() const {
+	return mDb.isOpen() && !mTable.isEmpty() && !mField.isEmpty();
+}
+
+bool SQLAttributeReader::hasError() const {
+	return mError;
+}
+
+int SQLAttributeReader::recordsRead() const {
+	return mRecordsRead;
+}
@@ -0,0 +1,69 @@
+#ifndef SQLATTRIBUTEREADER_H_
+#define SQLATTRIBUTEREADER_H_
+
+#include <QtSql>
+#include <QString>
+
+#include "SQLRawTheraRecords.h"
+
+/**
+ * Reads the (match_id, value) records of one attribute in match order, without making an SQLFragmentConf per match.
+ * See SQLDatabase::attributeReader()
+ *
+ * The records are fetched in chunks of chunkSize with a forward-only query that continues after the last match id of the
+ * previous chunk (WHERE match_id > last ORDER BY match_id LIMIT chunkSize), so every chunk is a range of the primary key
+ * and only one chunk is held in memory at a time, even by drivers that buffer the whole result set (MySQL).
+ *
+ * A chunk size of 0 reads everything with a single forward-only query instead. That's for the views, which would be computed
+ * all over again for every chunk, at the cost of the buffering drivers holding the whole result set.
+ *
+ * Matches that are added or removed while reading are seen or not depending on where the reader is, so for a consistent
+ * read it should happen inside a transaction.
+ *
+ *	SQLAttributeReader reader = db->attributeReader("status");
+ *	AttributeRecord record;
+ *
+ *	while (reader.next(record)) {
+ *		...
+ *	}
+ */
+class SQLAttributeReader {
+	public:
+		// table is where the field is a column of, the attribute table itself, matches or a (materialized) meta attribute
+		// condition is an extra WHERE clause the records have to satisfy, if any
+		SQLAttributeReader(const QSqlDatabase& db, const QString& table, const QString& field, int chunkSize = DEFAULT_CHUNK_SIZE, const QString& condition = QString());
+		virtual ~SQLAttributeReader();
+
+	public:
+		// the next record, false when they've all been read or a query failed (see hasError())
+		bool next(AttributeRecord& record);
+
+		// starts over from the first match
+		void reset();
+
+		bool isValid() const;
+		bool hasError() const;
+		int recordsRead() const;
+
+	public:
+		static const int DEFAULT_CHUNK_SIZE;
+
+	private:
+		bool fetch();
+
+	private:
+		QSqlDatabase mDb;
+		QString mTable;
+		QString mField;
+		int mChunkSize;
+		QString mCondition;
+
+		QSqlQuery mQuery;
+		int mLastMatchId;
+		int mInChunk; // how many records the current chunk had so far
+		bool mDone;
+		bool mError;
+		int mRecordsRead;
+};
+
+#endif /* SQLATTRIBUTEREADER_H_ */
@@ -0,0 +1,333 @@
+#include "SQLConnectionPool.h"
+
+#include <QMutexLocker>
+#include <QThreadStorage>
+#include <QtDebug>
+
+const int SQLConnectionPool::DEFAULT_MAX_CONNECTIONS = 4;
+const int SQLConnectionPool::DEFAULT_HEALTH_CHECK_INTERVAL = 60000;
+const int SQLConnectionPool::LEASE_TIMEOUT = 30000;
+
+QMutex SQLConnectionPool::mPoolsMutex;
+QHash<QString, QWeakPointer<SQLConnectionPool> > SQLConnectionPool::mPools;
+
+QMutex SQLConnectionPool::mRetiredMutex;
+QSet<QString> SQLConnectionPool::mRetired;
+
+// the connections a thread made, by the pool they came from, the ones that are left are closed when the thread exits
+struct SQLThreadConnections {
+	SQLThreadConnections(QThread *_thread) : thread(_thread) { }
+
+	~SQLThreadConnections() {
+		// a pool this held the last reference to is destroyed in here, its closeAll() shouldn't find them anymore
+		const QHash<QString, QWeakPointer<SQLConnectionPool> > own = connections;
+		connections.clear();
+
+		for (QHash<QString, QWeakPointer<SQLConnectionPool> >::const_iterator i = own.constBegin(); i != own.constEnd(); ++i) {
+			QSharedPointer<SQLConnectionPool> pool = i.value().toStrongRef();
+
+			if (pool) pool->forget(thread, i.key());
+
+			{
+				QMutexLocker locker(&SQLConnectionPool::mRetiredMutex);
+
+				SQLConnectionPool::mRetired.remove(i.key());
+			}
+
+			SQLConnectionPool::close(i.key());
+		}
+	}
+
+	QThread *thread;
+	QHash<QString, QWeakPointer<SQLConnectionPool> > connections;
+};
+
+static QThreadStorage<SQLThreadConnections *> threadConnections;
+
+QSharedPointer<SQLConnectionPool> SQLConnectionPool::get(const QString& connectionName) {
+	QMutexLocker locker(&mPoolsMutex);
+
+	// remove the pools nobody uses anymore
+	QMutableHashIterator<QString, QWeakPointer<SQLConnectionPool> > i(mPools);
+	while (i.hasNext()) {
+		if (i.next().value().isNull()) i.remove();
+	}
+
+	QSharedPointer<SQLConnectionPool> pool = mPools.value(connectionName).toStrongRef();
+
+	if (pool.isNull()) {
+		pool = QSharedPointer<SQLConnectionPool>(new SQLConnectionPool(connectionName));
+		pool->mSelf = pool.toWeakRef();
+
+		mPools.insert(connectionName, pool.toWeakRef());
+	}
+
+	return pool;
+}
+
+bool SQLConnectionPool::isAlive(const QSqlDatabase& db) {
+	if (!db.isValid() || !db.isOpen()) return false;
+
+	QSqlQuery query(db);
+
+	return query.exec("SELECT 1");
+}
+
+SQLConnectionPool::SQLConnectionPool(const QString& connectionName)
+	: mConnectionName(connectionName), mMaxConnections(DEFAULT_MAX_CONNECTIONS), mHealthCheckInterval(DEFAULT_HEALTH_CHECK_INTERVAL) {
+}
+
+SQLConnectionPool::~SQLConnectionPool() {
+	closeAll();
+}
+
+QSqlDatabase SQLConnectionPool::lease() {
+	QMutexLocker locker(&mMutex);
+
+	QThread *thread = QThread::currentThread();
+
+	closeRetired();
+
+	QHash<QThread *, Lease>::iterator i = mLeases.find(thread);
+
+	if (i != mLeases.end()) {
+		Lease& lease = i.value();
+
+		// a connection that is in use has just proven itself, only check the ones that were lying around
+		if (lease.refs == 0) {
+			const bool closed = !QSqlDatabase::database(lease.name, false).isOpen();
+
+			if (closed || (lease.idle.isValid() && lease.idle.elapsed() >= mHealthCheckInterval)) {
+				if (closed || !isAlive(QSqlDatabase::database(lease.name, false))) {
+					qDebug() << "SQLConnectionPool::lease: connection" << lease.name << "went away, reconnecting";
+
+					QSqlDatabase::database(lease.name, false).close();
+					open(lease.name);
+				}
+			}
+		}
+
+		++lease.refs;
+
+		return QSqlDatabase::database(lease.name, false);
+	}
+
+	QElapsedTimer waited;
+	waited.start();
+
+	while (mLeases.size() >= mMaxConnections && !retireIdle()) {
+		const int left = LEASE_TIMEOUT - int(waited.elapsed());
+
+		if (left <= 0 || !mReleased.wait(&mMutex, left)) {
+			qDebug() << "SQLConnectionPool::lease: all" << mMaxConnections << "connections to" << mConnectionName << "stayed in use, giving up";
+
+			return QSqlDatabase();
+		}
+	}
+
+	Lease lease;
+	lease.name = threadConnectionName(thread);
+	lease.refs = 1;
+
+	QSqlDatabase::cloneDatabase(QSqlDatabase::database(mConnectionName, false), lease.name);
+
+	// if it doesn't open it's kept anyway, the next lease() tries again
+	open(lease.name);
+
+	mLeases.insert(thread, lease);
+
+	if (!threadConnections.hasLocalData()) threadConnections.setLocalData(new SQLThreadConnections(thread));
+	threadConnections.localData()->connections.insert(lease.name, mSelf);
+
+	return QSqlDatabase::database(lease.name, false);
+}
+
+void SQLConnectionPool::release() {
+	QMutexLocker locker(&mMutex);
+
+	closeRetired();
+
+	QHash<QThread *, Lease>::iterator i = mLeases.find(QThread::currentThread());
+
+	if (i == mLeases.end()) {
+		qDebug() << "SQLConnectionPool::release: the calling thread didn't lease a connection to" << mConnectionName;
+
+		return;
+	}
+
+	Lease& lease = i.value();
+
+	if (--lease.refs <= 0) {
+		lease.refs = 0;
+		lease.idle.start();
+
+		mReleased.wakeOne();
+	}
+}
+
+QSqlDatabase SQLConnectionPool::connection() {
+	QMutexLocker locker(&mMutex);
+
+	QHash<QThread *, Lease>::const_iterator i = mLeases.constFind(QThread::currentThread());
+
+	if (i != mLeases.constEnd() && i.value().refs > 0) {
+		return QSqlDatabase::database(i.value().name, false);
+	}
+
+	// leasing here would keep the slot taken for as long as the thread lives
+	qDebug() << "SQLConnectionPool::connection: the calling thread doesn't hold a lease on a connection to" << mConnectionName;
+
+	return QSqlDatabase();
+}
+
+void SQLConnectionPool::closeConnection() {
+	QMutexLocker locker(&mMutex);
+
+	QThread *thread = QThread::currentThread();
+
+	closeRetired();
+
+	if (mLeases.contains(thread)) {
+		if (mLeases.value(thread).refs > 0) {
+			qDebug() << "SQLConnectionPool::closeConnection: closing connection" << mLeases.value(thread).name << "while it's still leased";
+		}
+
+		remove(thread);
+
+		mReleased.wakeAll();
+	}
+}
+
+void SQLConnectionPool::closeAll() {
+	QMutexLocker locker(&mMutex);
+
+	QThread *current = QThread::currentThread();
+
+	closeRetired();
+
+	foreach (QThread *thread, mLeases.keys()) {
+		if (thread == current) remove(thread);
+		else retire(thread);
+	}
+
+	mReleased.wakeAll();
+}
+
+void SQLConnectionPool::setMaxConnections(int connections) {
+	QMutexLocker locker(&mMutex);
+
+	mMaxConnections = qMax(1, connections);
+
+	// the connections above the limit are closed when they're idle and somebody needs a slot
+	mReleased.wakeAll();
+}
+
+int SQLConnectionPool::maxConnections() const {
+	QMutexLocker locker(&mMutex);
+
+	return mMaxConnections;
+}
+
+int SQLConnectionPool::size() const {
+	QMutexLocker locker(&mMutex);
+
+	return mLeases.size();
+}
+
+void SQLConnectionPool::setHealthCheckInterval(int msec) {
+	QMutexLocker locker(&mMutex);
+
+	mHealthCheckInterval = qMax(0, msec);
+}
+
+int SQLConnectionPool::healthCheckInterval() const {
+	QMutexLocker locker(&mMutex);
+
+	return mHealthCheckInterval;
+}
+
+QString SQLConnectionPool::threadConnectionName(QThread *thread) const {
+	return QString("%1_pool_%2").arg(mConnectionName).arg(quintptr(thread), 0, 16);
+}
+
+bool SQLConnectionPool::open(const QString& name) {
+	QSqlDatabase db = QSqlDatabase::database(name, false);
+
+	if (!db.open()) {
+		qDebug() << "SQLConnectionPool::open: could not open connection" << name << ":" << db.lastError();
+
+		return false;
+	}
+
+	qDebug() << "SQLConnectionPool::open: opened connection" << name;
+
+	return true;
+}
+
+void SQLConnectionPool::remove(QThread *thread) {
+	const QString name = mLeases.take(thread).name;
+
+	if (threadConnections.hasLocalData()) threadConnections.localData()->connections.remove(name);
+
+	close(name);
+}
+
+void SQLConnectionPool::retire(QThread *thread) {
+	QMutexLocker locker(&mRetiredMutex);
+
+	mRetired.insert(mLeases.take(thread).name);
+}
+
+void SQLConnectionPool::forget(QThread *thread, const QString& name) {
+	QMutexLocker locker(&mMutex);
+
+	QHash<QThread *, Lease>::iterator i = mLeases.find(thread);
+
+	// another thread at the same address might have its own by now
+	if (i != mLeases.end() && i.value().name == name) {
+		mLeases.erase(i);
+
+		mReleased.wakeAll();
+	}
+}
+
+void SQLConnectionPool::closeRetired() {
+	if (!threadConnections.hasLocalData()) return;
+
+	QHash<QString, QWeakPointer<SQLConnectionPool> >& connections = threadConnections.localData()->connections;
+
+	QMutexLocker locker(&mRetiredMutex);
+
+	QMutableHashIterator<QString, QWeakPointer<SQLConnectionPool> > i(connections);
+	while (i.hasNext()) {
+		if (mRetired.remove(i.next().key())) {
+			close(i.key());
+
+			i.remove();
+		}
+	}
+}
+
+void SQLConnectionPool::close(const QString& name) {
+	QSqlDatabase::database(name, false).close();
+	QSqlDatabase::removeDatabase(name);
+}
+
+bool SQLConnectionPool::retireIdle() {
+	QThread *oldest = NULL;
+	qint64 oldestIdle = -1;
+
+	for (QHash<QThread *, Lease>::const_iterator i = mLeases.constBegin(); i != mLeases.constEnd(); ++i) {
+		if (i.value().refs == 0 && i.value().idle.elapsed() > oldestIdle) {
+			oldest = i.key();
+			oldestIdle = i.value().idle.elapsed();
+		}
+	}
+
+	if (!oldest) return false;
+
+	// only its own thread may close it, the slot is free right away though
+	retire(oldest);
+
+	return true;
+}
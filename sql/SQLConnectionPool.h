@@ -0,0 +1,151 @@
+#ifndef SQLCONNECTIONPOOL_H_
+#define SQLCONNECTIONPOOL_H_
+
+#include <QtSql>
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSet>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QThread>
+#include <QElapsedTimer>
+
+/**
+ * Connections for the threads that read from a database next to the thread that opened it. A QSqlDatabase
+ * can only be used by the thread that created it, so every thread leases its own clone of the connection.
+ *
+ * There's one pool per database, keyed by the connection name (which is SQLConnectionDescription::getConnectionName()
+ * for databases opened through SQLDatabase::getDb). At most maxConnections() threads hold a connection at the same time,
+ * a thread that asks for one when they're all leased waits until one is released. Connections that were released are
+ * kept open for the thread that used them, unless another thread needs the slot.
+ *
+ * A connection that sat idle for longer than the health check interval is tested with a trivial query before it's
+ * handed out again, and reopened if it went away (MySQL and PostgreSQL servers drop idle connections).
+ *
+ * Connections are only closed by the thread that uses them: an idle connection that has to make room for another thread,
+ * or that belongs to another thread when closeAll() runs, is retired. That frees its slot right away, and its own thread
+ * closes it the next time it leases or releases a connection of any pool, or when it exits. Threads that are done with
+ * the database before that can call closeConnection().
+ *
+ * All methods are thread-safe.
+ */
+class SQLConnectionPool {
+	public:
+		// the pool for the connection with this name, made on first use, the connection itself has to be open to lease from it
+		static QSharedPointer<SQLConnectionPool> get(const QString& connectionName);
+
+		// a plain "SELECT 1", returns false if the connection went away even though isOpen() might still say it's open
+		static bool isAlive(const QSqlDatabase& db);
+
+		virtual ~SQLConnectionPool();
+
+	public:
+		// the connection of the calling thread, leases can be nested (each lease() needs a release())
+		// returns an invalid connection if none became available within LEASE_TIMEOUT milliseconds
+		QSqlDatabase lease();
+		void release();
+
+		// the connection the calling thread leased, an invalid one if it doesn't hold a lease
+		QSqlDatabase connection();
+
+		// closes and removes the connection of the calling thread, leased or not
+		void closeConnection();
+
+		// closes and removes the connection of the calling thread and retires those of the others, nothing can be leased while it runs
+		void closeAll();
+
+		void setMaxConnections(int connections);
+		int maxConnections() const;
+		int size() const;
+
+		// in milliseconds, 0 checks on every lease
+		void setHealthCheckInterval(int msec);
+		int healthCheckInterval() const;
+
+	public:
+		static const int DEFAULT_MAX_CONNECTIONS;
+		static const int DEFAULT_HEALTH_CHECK_INTERVAL;
+		static const int LEASE_TIMEOUT;
+
+	private:
+		SQLConnectionPool(const QString& connectionName);
+
+		// disabling copy-constructor and copy-assignment
+		SQLConnectionPool(const SQLConnectionPool&);
+		SQLConnectionPool& operator=(const SQLConnectionPool&);
+
+		// all of these expect mMutex to be locked
+		QString threadConnectionName(QThread *thread) const;
+		bool open(const QString& name);
+		void remove(QThread *thread); // only for the calling thread, the others have to be retired
+		void retire(QThread *thread);
+		bool retireIdle(); // makes room by retiring a connection that isn't leased, returns false if they're all in use
+
+		// called by a thread that exits while it still has the connection name, frees its slot
+		void forget(QThread *thread, const QString& name);
+
+		// closes the connections of the calling thread that were retired, of any pool
+		static void closeRetired();
+		static void close(const QString& name);
+
+		friend struct SQLThreadConnections;
+
+	private:
+		struct Lease {
+			Lease() : refs(0) { }
+
+			QString name;
+			int refs;
+			QElapsedTimer idle; // since the last release()
+		};
+
+		const QString mConnectionName;
+
+		mutable QMutex mMutex;
+		QWaitCondition mReleased;
+
+		QWeakPointer<SQLConnectionPool> mSelf; // for the threads to find their way back, see forget()
+
+		QHash<QThread *, Lease> mLeases;
+		int mMaxConnections;
+		int mHealthCheckInterval;
+
+		static QMutex mPoolsMutex;
+		static QHash<QString, QWeakPointer<SQLConnectionPool> > mPools;
+
+		// the connections that no longer have a slot, each is closed by the thread that made it
+		// they outlive the pool that retired them, the thread might only get to it after the pool is gone
+		static QMutex mRetiredMutex;
+		static QSet<QString> mRetired;
+};
+
+/**
+ * Leases the connection of the calling thread for as long as it exists, database() is invalid if the lease didn't succeed
+ */
+class SQLConnectionLease {
+	public:
+		SQLConnectionLease(const QSharedPointer<SQLConnectionPool>& pool) : mPool(pool) {
+			if (mPool) mDb = mPool->lease();
+
+			// nothing to release then
+			if (!mDb.isValid()) mPool.clear();
+		}
+
+		~SQLConnectionLease() {
+			if (mPool) mPool->release();
+		}
+
+		QSqlDatabase database() const { return mDb; }
+
+	private:
+		SQLConnectionLease(const SQLConnectionLease&);
+		SQLConnectionLease& operator=(const SQLConnectionLease&);
+
+	private:
+		QSharedPointer<SQLConnectionPool> mPool;
+		QSqlDatabase mDb;
+};
+
+#endif /* SQLCONNECTIONPOOL_H_ */
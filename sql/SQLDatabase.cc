@@ -6,6 +6,8 @@
 #include <QFile>
 #include <QTextStream>
 #include <QPair>
+#include <QElapsedTimer>
+#include <QtConcurrentRun>
 
 #include "XF.h"
 
@@ -15,11 +17,19 @@
 #include "SQLNullDatabase.h"
 
 #include "SQLConnectionDescription.h"
+#include "SQLImportBatch.h"
+#include "SQLImportPipeline.h"
+#include "SQLTransformationCodec.h"
+#include "SQLSyntheticDataset.h"
 
 using namespace thera;
 
 QHash<QString, QWeakPointer<SQLDatabase> > SQLDatabase::mActiveConnections;
 
+QHash<QString, int> SQLDatabase::mFieldIds;
+QStringList SQLDatabase::mFieldNames;
+QReadWriteLock SQLDatabase::mFieldIdLock;
+
 //const QString SQLDatabase::SCHEMA_FILE = "db/schema.sql";
 const QString SQLDatabase::SCHEMA_FILE = "config/matches_schema.sql";
 
@@ -28,6 +38,93 @@ const QString SQLDatabase::MATCHES_DOCTYPE = "matches-cache";
 const QString SQLDatabase::OLD_MATCHES_VERSION = "0.0";
 const QString SQLDatabase::MATCHES_VERSION = "1.0";
 
+const int SQLDatabase::BINARY_TRANSFORMATIONS_SCHEMA_VERSION = 2;
+
+const QString SQLDatabase::STATUS_FIELD = "status";
+const QString SQLDatabase::NUM_DUPLICATES_FIELD = "num_duplicates";
+const QString SQLDatabase::NUM_DUPLICATES_QUERY = "SELECT duplicate AS match_id, COUNT(duplicate) AS num_duplicates FROM duplicate GROUP BY duplicate";
+
+const QString SQLDatabase::MATERIALIZED_SETTING = "materialized_meta_attributes";
+const QString SQLDatabase::LAYOUT_SETTING = "attribute_layout";
+const QString SQLDatabase::WIDE_FIELDS_SETTING = "wide_match_fields";
+const QString SQLDatabase::SORT_INDEXES_SETTING = "sort_indexes";
+const QString SQLDatabase::HISTORY_INDEXES_SETTING = "history_indexes";
+const QString SQLDatabase::FAILED_HISTORY_INDEXES_SETTING = "failed_history_indexes";
+
+const int SQLDatabase::MAX_FETCH_GROUPS = 8;
+const int SQLDatabase::FETCH_GROUP_CHUNK_SIZE = 500;
+const int SQLDatabase::MAX_FETCH_GROUP_SIZE = 5000;
+
+const int SQLDatabase::DEFAULT_WRITE_DELAY = 500;
+
+// the queries behind the ...Async() methods
+class SQLMatchesQuery : public SQLAsyncQuery<QList<SQLFragmentConf> > {
+	public:
+		SQLMatchesQuery(SQLDatabase *db, const SQLQueryParameters& parameters) : mDb(db), mParameters(parameters) { }
+
+	protected:
+		virtual QList<SQLFragmentConf> execute() {
+			SQLConnectionLease lease(mDb->connectionPool());
+
+			return mDb->getMatches(mParameters);
+		}
+
+	private:
+		SQLDatabase *mDb;
+		SQLQueryParameters mParameters;
+};
+
+class SQLCountQuery : public SQLAsyncQuery<int> {
+	public:
+		SQLCountQuery(SQLDatabase *db, const SQLFilter& filter) : mDb(db), mFilter(filter) { }
+
+	protected:
+		virtual int execute() {
+			SQLConnectionLease lease(mDb->connectionPool());
+
+			return mDb->getNumberOfMatches(mFilter);
+		}
+
+	private:
+		SQLDatabase *mDb;
+		SQLFilter mFilter;
+};
+
+class SQLHistoryQuery : public SQLAsyncQuery<QList<HistoryRecord> > {
+	public:
+		SQLHistoryQuery(SQLDatabase *db, const QString& field, const QString& sortField, Qt::SortOrder order, const SQLFilter& filter, int offset, int limit)
+			: mDb(db), mField(field), mSortField(sortField), mOrder(order), mFilter(filter), mOffset(offset), mLimit(limit) { }
+
+	protected:
+		virtual QList<HistoryRecord> execute() {
+			SQLConnectionLease lease(mDb->connectionPool());
+
+			return mDb->getHistory(mField, mSortField, mOrder, mFilter, mOffset, mLimit);
+		}
+
+	private:
+		SQLDatabase *mDb;
+		QString mField;
+		QString mSortField;
+		Qt::SortOrder mOrder;
+		SQLFilter mFilter;
+		int mOffset;
+		int mLimit;
+};
+
+// the text form of a transformation as it is stored in matches.transformation and matches.xml
+static QString transformationToString(const XF& xf) {
+	QString xfs;
+
+	for (int col = 0; col < 4; ++col) {
+		for (int row = 0; row < 4; ++row) {
+			xfs += QString("%1 ").arg(xf[4 * row + col], 0, 'e', 20);
+		}
+	}
+
+	return xfs;
+}
+
 QSharedPointer<SQLDatabase> SQLDatabase::getDb(const QString& file, QObject *parent) {
 	SQLConnectionDescription dbd(file);
 	QSharedPointer<SQLDatabase> db;
@@ -48,7 +145,7 @@ QSharedPointer<SQLDatabase> SQLDatabase::getDb(const QString& file, QObject *par
 				// we should try to reopen and if that fails just remove the connection so that
 				// if the user tries to reconnect we don't return this dead connection
 				SQLDatabase *odb = i.value().data();
-				if (!odb->isOpen() && !odb->reopen()) {
+				if (odb->detectClosedDb() && !odb->reopen()) {
 					qDebug() << "SQLDatabase::getDb: pruned connection" << i.key() << "because it is no longer open and cannot be reopened";
 					i.remove();
 				}
@@ -157,6 +254,8 @@ bool SQLDatabase::open(const QString& connName, const QString& dbname, bool dbna
 
 			setPragmas();
 
+			mConnectionPool = SQLConnectionPool::get(mConnectionName);
+
 			if (!tables().contains("matches")) {
 				qDebug() << "SQLDatabase::open: database opened correctly but was found to be empty, setting up Thera schema";
 
@@ -168,6 +267,8 @@ bool SQLDatabase::open(const QString& connName, const QString& dbname, bool dbna
 				emit matchFieldsChanged();
 			}
 
+			readSettings();
+
 			// not necessary, will trigger on matchFieldsChanged() anyway
 			// if (mTrackHistory) createHistory();
 
@@ -192,7 +293,17 @@ bool SQLDatabase::open(const QString& connName, const QString& dbname, bool dbna
 // been set up properly at least once (i.e.: it is dumb and for internal use)
 // return true for success and false for failure
 bool SQLDatabase::reopen() {
-	return QSqlDatabase::database(mConnectionName, true).isOpen();
+	QSqlDatabase db = QSqlDatabase::database(mConnectionName, false);
+
+	// a connection the server dropped can still claim to be open
+	db.close();
+	resetQueries();
+
+	if (!db.open()) return false;
+
+	setPragmas();
+
+	return true;
 }
 
 QString SQLDatabase::connectionName() const {
@@ -200,9 +311,17 @@ QString SQLDatabase::connectionName() const {
 }
 
 SQLDatabase::SQLDatabase(QObject *parent, const QString& type, bool trackHistory)
-	: QObject(parent), mType(type), mTrackHistory(trackHistory) {
+	: QObject(parent), mType(type), mTrackHistory(trackHistory), mImportBatchSize(SQLImportBatch::DEFAULT_BATCH_SIZE), mImportPipeline(NULL), mBinaryTransformations(false), mFlushedHistory(0), mWriteDelay(DEFAULT_WRITE_DELAY), mModificationCount(0), mStatusHistogramValid(false), mCountGeneration(0) {
 	setOptions(UseLateRowLookup | UseViewEncapsulation | ForcePrimaryIndex);
 
+	mWriteTimer.setSingleShot(true);
+	QObject::connect(&mWriteTimer, SIGNAL(timeout()), this, SLOT(sync()));
+	QObject::connect(&mImportWatcher, SIGNAL(finished()), this, SLOT(xmlParsed()));
+
+	// every thread of the pool keeps a connection open, so a few threads that stay around are best
+	mQueryPool.setMaxThreadCount(2);
+	mQueryPool.setExpiryTimeout(-1);
+
 	//QObject::connect(this, SIGNAL(databaseClosed()), this, SLOT(resetQueries()));
 	QObject::connect(this, SIGNAL(matchFieldsChanged()), this, SLOT(makeFieldsSet()));
 	QObject::connect(this, SIGNAL(matchFieldsChanged()), this, SLOT(createHistory()));
@@ -238,8 +357,7 @@ bool SQLDatabase::isOpen() const {
 }
 
 bool SQLDatabase::detectClosedDb() const {
-	// TODO: build real detection code for MySQL (i.e.: prepare a statement and see if it errors out)
-	return !isOpen();
+	return !SQLConnectionPool::isAlive(database());
 }
 
 // the default implementation does nothing
@@ -269,6 +387,10 @@ bool SQLDatabase::hasCorrectCapabilities() const {
 	);
 }
 
+QString SQLDatabase::blobSqlType() const {
+	return QString("BLOB");
+}
+
 QString SQLDatabase::schemaName() const {
 	// for db's that act like MySQL
 	return database().databaseName();
@@ -325,455 +447,1815 @@ QStringList SQLDatabase::tables(QSql::TableType type) const {
 }
 
 bool SQLDatabase::transaction() const {
+	// what was written before the transaction doesn't belong to it
+	sync();
+
 	return database().transaction();
 }
 
 bool SQLDatabase::commit() const {
-	return database().commit();
-}
+	const bool flushed = flushWrites();
+	const bool committed = database().commit();
 
-void SQLDatabase::createIndex(const QString& table, const QStringList& fields) {
-	QSqlQuery query(database());
-	if (query.exec(QString("CREATE INDEX %3_index ON %1(%2);").arg(table).arg(fields.join(",")).arg(fields.join("_")))) {
-		qDebug() << "SQLDatabase::createIndex: successfully created index on field(s)" << fields << "on table" << table;
-	}
-	else {
-		qDebug() << "SQLDatabase::createIndex: failed creating index" << fields << "on" << table << "->" << query.lastError();
-	}
+	writesCommitted(flushed && committed);
+
+	return flushed && committed;
 }
 
-thera::SQLFragmentConf SQLDatabase::addMatch(const QString& sourceName, const QString& targetName, const thera::XF& xf, int id) {
-	const QString queryKey = (id == -1) ? "addMatchNoId" : "addMatchWithId";
-	const QString queryString = (id == -1)
-			?
-			"INSERT INTO matches (source_id, source_name, target_id, target_name, transformation) "
-			"VALUES (:source_id, :source_name, :target_id, :target_name, :transformation)"
-			:
-			"INSERT INTO matches (match_id, source_id, source_name, target_id, target_name, transformation) "
-			"VALUES (:match_id, :source_id, :source_name, :target_id, :target_name, :transformation)";
+void SQLDatabase::setWriteDelay(int msec) {
+	mWriteDelay = qMax(0, msec);
 
-	QSqlQuery &query = getOrElse(queryKey, queryString);
+	if (mWriteDelay == 0) sync();
+}
 
-	QString xfs;
+int SQLDatabase::writeDelay() const {
+	return mWriteDelay;
+}
 
-	for (int col = 0; col < 4; ++col) {
-		for (int row = 0; row < 4; ++row) {
-			xfs += QString("%1 ").arg(xf[4 * row + col], 0, 'e', 20);
-		}
-	}
+int SQLDatabase::pendingWrites() const {
+	QMutexLocker locker(&mWriteMutex);
 
-	if (id != -1) query.bindValue(":match_id", id);
-	query.bindValue(":source_id", 0); // TODO: not use dummy value
-	query.bindValue(":source_name", sourceName);
-	query.bindValue(":target_id", 0); // TODO: not use dummy value
-	query.bindValue(":target_name", targetName);
-	query.bindValue(":transformation", xfs);
+	return mPendingWrites.size();
+}
 
-	SQLDatabase *db = NULL;
-	int realId = -1;
-	int fragments[IFragmentConf::MAX_FRAGMENTS];
+bool SQLDatabase::sync() const {
+	// the owning thread flushes before it hands queries to the others, they have nothing to write
+	if (QThread::currentThread() != thread()) return true;
 
-	if (query.exec()) {
-		db = this;
-		realId = query.lastInsertId().toInt();
+	{
+		QMutexLocker locker(&mWriteMutex);
 
-		fragments[IFragmentConf::SOURCE] = Database::entryIndex(sourceName);
-		fragments[IFragmentConf::TARGET] = Database::entryIndex(targetName);
+		if (mPendingWrites.isEmpty() && mPendingHistory.isEmpty()) return true;
 	}
-	else {
-		qDebug() << "SQLDatabase::addMatch: could not insert match record, returning invalid SQLFragmentConf:" << query.lastError();
 
-		fragments[IFragmentConf::SOURCE] = -1;
-		fragments[IFragmentConf::TARGET] = -1;
-	}
+	QSqlDatabase db = database();
 
-	if (id != -1 && realId != id) {
-		qDebug() << "SQLDatabase::addMatch: the inserted id was valid but differed from the requested id. Got " << realId << " as opposed to requested id" << id
-			<< "\n\tqueryKey =" << queryKey
-			<< "\n\t" << query.lastQuery()
-			<< "\n\t" << query.boundValues();
+	// not through transaction() and commit(), those flush themselves
+	const bool ownTransaction = db.transaction();
+	bool succes = flushWrites();
+
+	if (ownTransaction) {
+		if (succes) succes = db.commit();
+		else db.rollback();
 	}
 
-	return SQLFragmentConf(db, realId, fragments, 1.0f, xf);
+	writesCommitted(succes);
+
+	return succes;
 }
 
-QSet<SQLDatabase::SpecialCapabilities> SQLDatabase::supportedCapabilities() const { return QSet<SpecialCapabilities>(); }
-bool SQLDatabase::supports(SpecialCapabilities) const { return false; }
+bool SQLDatabase::flushWrites() const {
+	if (QThread::currentThread() != thread()) return false;
 
-void SQLDatabase::setConnectOptions() const {
-	// the default is no connection options
-}
+	QHash<quint64, PendingWrite> writes;
+	QList<PendingWrite> pendingHistory;
 
-void SQLDatabase::loadFromXML(const QString& XMLFile) {
-	if (XMLFile == "" || !isOpen()) {
-		qDebug("SQLDatabase::loadFromXML: filename was empty or database is not open, aborting...");
+	// they stay queued until writesCommitted() knows they made it
+	{
+		QMutexLocker locker(&mWriteMutex);
 
-		return;
+		mFlushedWrites.clear();
+		mFlushedHistory = 0;
+
+		if (mPendingWrites.isEmpty() && mPendingHistory.isEmpty()) return true;
+
+		writes = mPendingWrites;
+		pendingHistory = mPendingHistory;
+
+		mFlushedWrites = writes;
+		mFlushedHistory = pendingHistory.size();
 	}
 
-	QFile file(XMLFile);
+	mWriteTimer.stop();
 
-	// open the file in read-only mode
-	if (file.open(QIODevice::ReadOnly)) {
-		QDomDocument doc;
+	QElapsedTimer timer;
+	timer.start();
 
-		bool succes = doc.setContent(&file);
+	bool succes = true;
 
-		file.close();
+	// one batch per attribute
+	QMap<QString, QPair<QVariantList, QVariantList> > updates;
 
-		if (succes) {
-			QDomElement root(doc.documentElement());
+	foreach (const PendingWrite& write, writes) {
+		QPair<QVariantList, QVariantList>& update = updates[write.field];
+
+		update.first << write.value.toString();
+		update.second << write.matchId;
+	}
 
-			qDebug() << "SQLDatabase::loadFromXML: Starting to parse XML";
+	QMap<QString, QList<QVariantList> > history;
 
-			parseXML(root);
+	foreach (const PendingWrite& write, pendingHistory) {
+		QList<QVariantList>& columns = history[write.field];
+		if (columns.isEmpty()) columns << QVariantList() << QVariantList() << QVariantList() << QVariantList();
 
-			qDebug() << "SQLDatabase::loadFromXML: Done parsing XML, adding extra attributes:";
+		columns[0] << write.timestamp;
+		columns[1] << 0;
+		columns[2] << write.matchId;
+		columns[3] << write.value.toString();
+	}
 
-			addMatchField("comment", "");
-			addMatchField("duplicate", 0);
-			addMetaMatchField("num_duplicates", "SELECT duplicate AS match_id, COUNT(duplicate) AS num_duplicates FROM duplicate GROUP BY duplicate");
+	QSqlQuery query(database());
 
-			//emit matchFieldsChanged(); <--- in general already called by the addMatchField calls (takes care of available attributes management and history creation)
-			emit matchCountChanged();
+	for (QMap<QString, QPair<QVariantList, QVariantList> >::const_iterator i = updates.constBegin(); i != updates.constEnd(); ++i) {
+		query.prepare(QString("UPDATE %2 SET %1 = ? WHERE match_id = ?").arg(i.key()).arg(fieldTable(i.key())));
+		query.addBindValue(i.value().first);
+		query.addBindValue(i.value().second);
 
-			qDebug() << "SQLDatabase::loadFromXML: Done adding extra attributes, hopefully nothing went wrong";
-		}
-		else {
-			qDebug() << "Reading XML file" << XMLFile << "failed";
+		if (!query.execBatch()) {
+			qDebug() << "SQLDatabase::flushWrites: couldn't write" << i.value().second.size() << "values of" << i.key() << "->" << query.lastError();
+
+			succes = false;
 		}
 	}
-	else {
-		qDebug() << "Could not open"  << XMLFile;
-	}
-}
 
-void SQLDatabase::stressTestFromXML(const QString& XMLFile, int factor, bool perturb) {
-	if (XMLFile == "" || !isOpen()) {
-		qDebug("SQLDatabase::loadFromXML: filename was empty or database is not open, aborting...");
+	for (QMap<QString, QList<QVariantList> >::const_iterator i = history.constBegin(); i != history.constEnd(); ++i) {
+		query.prepare(QString("INSERT INTO %1_history (timestamp, user_id, match_id, %1) VALUES (?, ?, ?, ?)").arg(i.key()));
 
-		return;
-	}
+		foreach (const QVariantList& column, i.value()) {
+			query.addBindValue(column);
+		}
 
-	QFile file(XMLFile);
+		if (!query.execBatch()) {
+			qDebug() << "SQLDatabase::flushWrites: couldn't write" << i.value().first().size() << "history records of" << i.key() << "->" << query.lastError();
 
-	// open the file in read-only mode
-	if (file.open(QIODevice::ReadOnly)) {
-		QDomDocument doc;
+			succes = false;
+		}
+	}
 
-		bool succes = doc.setContent(&file);
+	qDebug() << "SQLDatabase::flushWrites: wrote" << writes.size() << "values in" << timer.elapsed() << "msec";
 
-		file.close();
+	return succes;
+}
 
-		if (succes) {
-			QDomElement root(doc.documentElement());
+void SQLDatabase::writesCommitted(bool committed) const {
+	QHash<quint64, PendingWrite> flushed;
 
-			qDebug() << "SQLDatabase::stressTestFromXML: Starting to parse XML";
+	{
+		QMutexLocker locker(&mWriteMutex);
 
-			parseXMLStressTest(root, factor, perturb);
+		flushed = mFlushedWrites;
+		mFlushedWrites.clear();
 
-			qDebug() << "SQLDatabase::stressTestFromXML: Done parsing XML, adding extra attributes:";
+		if (committed) {
+			// a fetch group might have read one of the old values in the meantime, and an UPDATE that matched
+			// no row didn't change anything, so the values are read back instead of assumed. That's dropped
+			// while the queue still answers for them, a value that was queued again after the flush stays
+			for (QHash<quint64, PendingWrite>::const_iterator i = flushed.constBegin(); i != flushed.constEnd(); ++i) {
+				mAttributeCache.invalidate(i.value().matchId, fieldId(i.value().field));
 
-			addMatchField("comment", "");
-			addMatchField("duplicate", 0);
-			addMetaMatchField("num_duplicates", "SELECT duplicate AS match_id, COUNT(duplicate) AS num_duplicates FROM duplicate GROUP BY duplicate");
+				QHash<quint64, PendingWrite>::iterator pending = mPendingWrites.find(i.key());
 
-			//emit matchFieldsChanged(); <--- in general already called by the addMatchField calls (takes care of available attributes management and history creation)
-			emit matchCountChanged();
+				if (pending != mPendingWrites.end() && pending.value().timestamp == i.value().timestamp && pending.value().value == i.value().value) {
+					mPendingWrites.erase(pending);
+				}
+			}
 
-			qDebug() << "SQLDatabase::stressTestFromXML: Done adding extra attributes, hopefully nothing went wrong";
+			mPendingHistory = mPendingHistory.mid(mFlushedHistory);
 		}
-		else {
-			qDebug() << "Reading XML file" << XMLFile << "failed";
-		}
-	}
-	else {
-		qDebug() << "Could not open"  << XMLFile;
-	}
-}
-
-void SQLDatabase::saveToXML(const QString& XMLFile) {
-	if (XMLFile == "") {
-		qDebug("SQLDatabase::saveToXML: filename was empty, aborting...");
 
-		return;
+		mFlushedHistory = 0;
 	}
 
-	QFile file(XMLFile);
-
-	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-		QTextStream out(&file);
-		QDomDocument doc(toXML());
+	if (!committed && !flushed.isEmpty()) {
+		// they're still queued, so matchGetValue() keeps returning them and the next sync point tries again
+		qDebug() << "SQLDatabase::writesCommitted:" << flushed.size() << "attribute writes couldn't be written, they stay queued";
 
-		doc.save(out, 1);
-		file.close();
-	}
-	else {
-		qDebug() << "SQLDatabase::saveToXML: Could not open"  << XMLFile;
+		emit const_cast<SQLDatabase *>(this)->writesFailed(flushed.size());
 	}
 }
 
-bool SQLDatabase::addMatchField(const QString& name, double defaultValue) {
-	if (addMatchField(name, "REAL", defaultValue)) {
-		emit matchFieldsChanged();
+bool SQLDatabase::createIndex(const QString& table, const QStringList& fields) {
+	QSqlQuery query(database());
+	if (query.exec(QString("CREATE INDEX %3 ON %1(%2);").arg(table).arg(fields.join(",")).arg(indexName(fields)))) {
+		qDebug() << "SQLDatabase::createIndex: successfully created index on field(s)" << fields << "on table" << table;
 
 		return true;
 	}
+	else {
+		qDebug() << "SQLDatabase::createIndex: failed creating index" << fields << "on" << table << "->" << query.lastError();
 
-	return false;
+		return false;
+	}
 }
 
-bool SQLDatabase::addMatchField(const QString& name, const QString& defaultValue) {
-	if (addMatchField(name, "TEXT", defaultValue)) {
-		emit matchFieldsChanged();
+bool SQLDatabase::dropIndex(const QString&, const QStringList& fields) {
+	QSqlQuery query(database());
 
-		return true;
+	if (!query.exec(QString("DROP INDEX IF EXISTS %1").arg(indexName(fields)))) {
+		qDebug() << "SQLDatabase::dropIndex: failed dropping index" << fields << "->" << query.lastError();
+
+		return false;
 	}
 
-	return false;
+	return true;
 }
 
-bool SQLDatabase::addMatchField(const QString& name, int defaultValue) {
-	if (addMatchField(name, "INTEGER", defaultValue)) {
-		emit matchFieldsChanged();
-
-		return true;
-	}
-
-	return false;
+QString SQLDatabase::explainQuery(const QString& query) const {
+	return "EXPLAIN " + query;
 }
 
-template<typename T> bool SQLDatabase::addMatchField(const QString& name, const QString& sqlType, T defaultValue, bool indexValue) {
-	if (matchHasField(name)) {
-		qDebug() << "SQLDatabase::addMatchField: field" << name << "already exists";
+QStringList SQLDatabase::explain(const QString& query) const {
+	QStringList plan;
 
-		return false;
-	}
+	if (query.isEmpty()) return plan;
 
-	if (!isOpen()) {
-		qDebug() << "SQLDatabase::addMatchField: database wasn't open";
+	QSqlQuery q(database());
+	q.setForwardOnly(true);
 
-		return false;
+	if (!q.exec(explainQuery(query))) {
+		qDebug() << "SQLDatabase::explain: couldn't explain query:" << q.lastError() << "\n\tQUERY =" << query;
+
+		return plan;
 	}
 
-	bool success = false;
+	while (q.next()) {
+		const QSqlRecord record = q.record();
+		QStringList columns;
 
-	QSqlDatabase db = database();
-	QSqlQuery query(db);
+		for (int i = 0; i < record.count(); ++i) {
+			columns << record.value(i).toString();
+		}
 
-	if (!transaction()) {
-		qDebug() << "SQLDatabase::addMatchField: could NOT start a transaction, the following might be very slow";
+		plan << columns.join(" | ");
 	}
 
-	/*
-	if (query.exec("START TRANSACTION")) qDebug() << "SQLDatabase::addMatchField: Correctly manually started a transaction";
-	else qDebug() << "SQLDatabase::addMatchField can't start transaction:" << query.lastError();
-
-	if (query.exec("BEGIN")) qDebug() << "SQLDatabase::addMatchField: Correctly manually started a transaction";
-	else qDebug() << "SQLDatabase::addMatchField can't start transaction:" << query.lastError();
-	*/
-
-	success = query.exec(QString("CREATE TABLE %1 (match_id INTEGER PRIMARY KEY AUTOINCREMENT, %1 %2 NOT NULL DEFAULT %3, confidence REAL NOT NULL DEFAULT 1)").arg(name).arg(sqlType).arg(defaultValue));
-	if (success) {
-		// insert the default value everywhere
-		query.prepare(QString(
-			"INSERT INTO %1 (match_id, %1, confidence) "
-			"VALUES (:match_id, :value, :confidence)"
-		).arg(name));
+	return plan;
+}
 
-		//int i = 0;
-		//int step = 100;
-		QElapsedTimer timer;
-		timer.start();
+QString SQLDatabase::indexName(const QStringList& fields) {
+	return fields.join("_") + "_index";
+}
 
-		QSqlQuery idQuery(db);
-		query.setForwardOnly(true);
-		if (idQuery.exec("SELECT match_id FROM matches")) {
-			qDebug() << "SQLDatabase::addMatchField: Fetched all matches in" << timer.restart() << "msec";
+bool SQLDatabase::createSortIndex(const QString& table, const QString& field) {
+	// queries sort on match_id after the attribute, with both in the index they don't need a sort step
+	if (!supports(COMPOSITE_SORT_INDEX)) return createIndex(table, QStringList() << field);
 
-			while (idQuery.next()) {
-				query.bindValue(":match_id", idQuery.value(0).toInt());
-				query.bindValue(":value", defaultValue);
-				query.bindValue(":confidence", 1.0);
+	if (!createIndex(table, QStringList() << field << "match_id")) return false;
 
-				query.exec();
+	const QStringList indexed = setting(SORT_INDEXES_SETTING).split(",", QString::SkipEmptyParts);
 
-				/*
-				if (++i % step == 0) {
-					qDebug() << "Inserted another" << step << "rows for field" << name << "now at" << i << "used" << timer.restart() << "msec";
-				}
-				*/
-			}
-		}
-		else {
-			qDebug() << "SQLDatabase::addMatchField couldn't create default values:" << idQuery.lastError()
-				<< "\nQuery executed:" << idQuery.lastQuery();
-		}
+	if (!indexed.contains(field)) setSetting(SORT_INDEXES_SETTING, (indexed + QStringList(field)).join(","));
 
-		if (indexValue) {
-			createIndex(name, QStringList() << name);
-		}
+	mSortIndexFields << field;
 
-		qDebug() << "SQLDatabase::addMatchField succesfully created field:" << name;
+	return true;
+}
 
-		//emit matchFieldsChanged();
-	}
-	else {
-		qDebug() << "SQLDatabase::addMatchField couldn't create table:" << query.lastError()
-			<< "\nQuery executed:" << query.lastQuery();
-	}
+bool SQLDatabase::createHistoryIndex(const QString& field) {
+	// indexName() would give every history table an index with the same name
+	QSqlQuery query(database());
 
-	commit();
+	if (!query.exec(QString("CREATE INDEX %1_history_index ON %1_history(match_id, timestamp)").arg(field))) {
+		qDebug() << "SQLDatabase::createHistoryIndex: failed creating history index for" << field << "->" << query.lastError() << ", not trying again";
 
-	return success;
-}
+		// whatever made it fail (an index that was there already, ...) will most likely still be the case the next time
+		const QStringList failed = setting(FAILED_HISTORY_INDEXES_SETTING).split(",", QString::SkipEmptyParts);
 
-/**
- * @param name
- * 		The name of the new attribute
- * @param sql
- * 		SQL code to create the view which will create a VIEW that can serve as a regular attribute
- */
-bool SQLDatabase::addMetaMatchField(const QString& name, const QString& sql) {
-	if (matchHasField(name)) {
-		qDebug() << "SQLDatabase::addMetaMatchField: field" << name << "already exists";
+		if (!failed.contains(field)) setSetting(FAILED_HISTORY_INDEXES_SETTING, (failed + QStringList(field)).join(","));
 
 		return false;
 	}
 
-	if (!isOpen()) {
-		qDebug() << "SQLDatabase::addMatchField: database wasn't open";
+	const QStringList indexed = setting(HISTORY_INDEXES_SETTING).split(",", QString::SkipEmptyParts);
+
+	if (!indexed.contains(field)) setSetting(HISTORY_INDEXES_SETTING, (indexed + QStringList(field)).join(","));
+
+	return true;
+}
+
+QString SQLDatabase::sortIndexName(const QString& field) const {
+	return indexName(mSortIndexFields.contains(field) ? (QStringList() << field << "match_id") : QStringList(field));
+}
+
+thera::SQLFragmentConf SQLDatabase::addMatch(const QString& sourceName, const QString& targetName, const thera::XF& xf, int id) {
+	const QString queryKey = QString((id == -1) ? "addMatchNoId" : "addMatchWithId") + transformationColumn();
+	const QString queryString = QString((id == -1)
+			?
+			"INSERT INTO matches (source_id, source_name, target_id, target_name, %1) "
+			"VALUES (:source_id, :source_name, :target_id, :target_name, :transformation)"
+			:
+			"INSERT INTO matches (match_id, source_id, source_name, target_id, target_name, %1) "
+			"VALUES (:match_id, :source_id, :source_name, :target_id, :target_name, :transformation)").arg(transformationColumn());
+
+	QSqlQuery &query = getOrElse(queryKey, queryString);
+
+	if (id != -1) query.bindValue(":match_id", id);
+	query.bindValue(":source_id", 0); // TODO: not use dummy value
+	query.bindValue(":source_name", sourceName);
+	query.bindValue(":target_id", 0); // TODO: not use dummy value
+	query.bindValue(":target_name", targetName);
+	query.bindValue(":transformation", mBinaryTransformations ? QVariant(encodeTransformation(xf)) : QVariant(transformationToString(xf)));
+
+	SQLDatabase *db = NULL;
+	int realId = -1;
+	int fragments[IFragmentConf::MAX_FRAGMENTS];
+
+	if (query.exec()) {
+		db = this;
+		realId = query.lastInsertId().toInt();
+
+		clearCountCache();
+		++mModificationCount;
+
+		fragments[IFragmentConf::SOURCE] = Database::entryIndex(sourceName);
+		fragments[IFragmentConf::TARGET] = Database::entryIndex(targetName);
+	}
+	else {
+		qDebug() << "SQLDatabase::addMatch: could not insert match record, returning invalid SQLFragmentConf:" << query.lastError();
+
+		fragments[IFragmentConf::SOURCE] = -1;
+		fragments[IFragmentConf::TARGET] = -1;
+	}
+
+	if (id != -1 && realId != id) {
+		qDebug() << "SQLDatabase::addMatch: the inserted id was valid but differed from the requested id. Got " << realId << " as opposed to requested id" << id
+			<< "\n\tqueryKey =" << queryKey
+			<< "\n\t" << query.lastQuery()
+			<< "\n\t" << query.boundValues();
+	}
+
+	return SQLFragmentConf(db, realId, fragments, 1.0f, xf);
+}
+
+int SQLDatabase::fieldId(const QString& field) {
+	if (field.isEmpty()) return -1;
+
+	{
+		QReadLocker locker(&mFieldIdLock);
+
+		QHash<QString, int>::const_iterator i = mFieldIds.constFind(field);
+		if (i != mFieldIds.constEnd()) return i.value();
+	}
+
+	QWriteLocker locker(&mFieldIdLock);
+
+	// field names are case-insensitive, the spelling that was asked for becomes an alias of the lowercase one
+	const QString lower = field.toLower();
+	int id = mFieldIds.value(lower, -1);
+
+	if (id == -1) {
+		id = mFieldNames.size();
+
+		mFieldNames << lower;
+		mFieldIds.insert(lower, id);
+	}
+
+	mFieldIds.insert(field, id);
+
+	return id;
+}
+
+QString SQLDatabase::fieldName(int fieldId) {
+	QReadLocker locker(&mFieldIdLock);
+
+	return (fieldId >= 0 && fieldId < mFieldNames.size()) ? mFieldNames.at(fieldId) : QString();
+}
+
+bool SQLDatabase::canCloneConnection() const {
+	return true;
+}
+
+QSharedPointer<SQLConnectionPool> SQLDatabase::connectionPool() const {
+	return mConnectionPool;
+}
+
+QSet<SQLDatabase::SpecialCapabilities> SQLDatabase::supportedCapabilities() const { return QSet<SpecialCapabilities>(); }
+bool SQLDatabase::supports(SpecialCapabilities) const { return false; }
+
+void SQLDatabase::setConnectOptions() const {
+	// the default is no connection options
+}
+
+void SQLDatabase::setImportBatchSize(int matches) {
+	mImportBatchSize = qMax(1, matches);
+}
+
+int SQLDatabase::importBatchSize() const {
+	return mImportBatchSize;
+}
+
+void SQLDatabase::loadFromXML(const QString& XMLFile) {
+	if (XMLFile == "" || !isOpen()) {
+		qDebug("SQLDatabase::loadFromXML: filename was empty or database is not open, aborting...");
+
+		return;
+	}
+
+	if (mImportPipeline) {
+		qDebug() << "SQLDatabase::loadFromXML: still importing another file, aborting...";
+
+		return;
+	}
+
+	QStringList integerAttributes = QStringList() << "status";
+	QStringList floatAttributes = QStringList() << "error" << "overlap" << "volume" << "old_volume" << "probability";
+	QStringList stringAttributes = QStringList();
+
+	// create the attribute tables if they don't exist
+	foreach (const QString& attr, integerAttributes) {
+		if (!matchHasRealField(attr)) addMatchField(attr, "INTEGER", "0");
+	}
+
+	foreach (const QString& attr, floatAttributes) {
+		if (!matchHasRealField(attr)) addMatchField(attr, "REAL", "0");
+	}
+
+	foreach (const QString& attr, stringAttributes) {
+		if (!matchHasRealField(attr)) addMatchField(attr, "TEXT", "0");
+	}
+
+	// worker threads convert chunks of raw matches while a writer thread with its own connection inserts them
+	mImportPipeline = new SQLImportPipeline(database(), supports(MULTI_ROW_INSERT), mImportBatchSize, canCloneConnection());
+	mImportPipeline->setBinaryTransformations(mBinaryTransformations);
+	mImportPipeline->setMatchColumns(wideMatchFields());
+
+	qDebug() << "SQLDatabase::loadFromXML: Starting to parse XML";
+
+	if (canCloneConnection()) {
+		// the parsing happens on a worker as well, xmlParsed() picks up the result
+		mImportWatcher.setFuture(QtConcurrent::run(this, &SQLDatabase::importXML, XMLFile, mImportPipeline));
+	}
+	else {
+		// the pipeline writes through the connection of this thread then, which can't be used anywhere else
+		finishXMLImport(importXML(XMLFile, mImportPipeline));
+	}
+}
+
+void SQLDatabase::xmlParsed() {
+	// close() already waited for it
+	if (!mImportPipeline) return;
+
+	finishXMLImport(mImportWatcher.result());
+}
+
+void SQLDatabase::finishXMLImport(bool succes) {
+	delete mImportPipeline;
+	mImportPipeline = NULL;
+
+	if (succes) {
+		qDebug() << "SQLDatabase::loadFromXML: Done parsing XML, adding extra attributes:";
+
+		addMatchField("comment", "");
+		addMatchField("duplicate", 0);
+		addMetaMatchField(NUM_DUPLICATES_FIELD, NUM_DUPLICATES_QUERY);
+		materializeMetaAttributes();
+
+		//emit matchFieldsChanged(); <--- in general already called by the addMatchField calls (takes care of available attributes management and history creation)
+		mAttributeCache.clear(); // matches that were cached as not having a value might have one now
+		clearCountCache();
+		++mModificationCount;
+		emit matchCountChanged();
+
+		qDebug() << "SQLDatabase::loadFromXML: Done adding extra attributes, hopefully nothing went wrong";
+	}
+
+	emit xmlLoaded(succes);
+}
+
+bool SQLDatabase::importXML(const QString& XMLFile, SQLImportPipeline *pipeline) {
+	QFile file(XMLFile);
+
+	// open the file in read-only mode
+	if (!file.open(QIODevice::ReadOnly)) {
+		qDebug() << "Could not open"  << XMLFile;
+
+		return false;
+	}
+
+	// the file is streamed, only one <match> element is in memory at any time, this keeps
+	// memory usage flat regardless of the size of the matches file
+	QXmlStreamReader xml(&file);
+
+	bool succes = parseXML(xml, file.size(), *pipeline);
+
+	if (!succes) {
+		qDebug() << "Reading XML file" << XMLFile << "failed:" << xml.errorString() << "at line" << xml.lineNumber();
+	}
+
+	file.close();
+
+	return succes;
+}
+
+void SQLDatabase::stressTestFromXML(const QString& XMLFile, int factor, bool perturb) {
+	if (XMLFile == "" || !isOpen()) {
+		qDebug("SQLDatabase::loadFromXML: filename was empty or database is not open, aborting...");
+
+		return;
+	}
+
+	QFile file(XMLFile);
+
+	// open the file in read-only mode
+	if (file.open(QIODevice::ReadOnly)) {
+		QXmlStreamReader xml(&file);
+
+		qDebug() << "SQLDatabase::stressTestFromXML: Starting to parse XML";
+
+		bool succes = parseXMLStressTest(xml, file.size(), factor, perturb);
+
+		file.close();
+
+		if (succes) {
+			qDebug() << "SQLDatabase::stressTestFromXML: Done parsing XML, adding extra attributes:";
+
+			addMatchField("comment", "");
+			addMatchField("duplicate", 0);
+			addMetaMatchField(NUM_DUPLICATES_FIELD, NUM_DUPLICATES_QUERY);
+			materializeMetaAttributes();
+
+			//emit matchFieldsChanged(); <--- in general already called by the addMatchField calls (takes care of available attributes management and history creation)
+			mAttributeCache.clear(); // matches that were cached as not having a value might have one now
+			clearCountCache();
+			++mModificationCount;
+			emit matchCountChanged();
+
+			qDebug() << "SQLDatabase::stressTestFromXML: Done adding extra attributes, hopefully nothing went wrong";
+		}
+		else {
+			qDebug() << "Reading XML file" << XMLFile << "failed:" << xml.errorString() << "at line" << xml.lineNumber();
+		}
+	}
+	else {
+		qDebug() << "Could not open"  << XMLFile;
+	}
+}
+
+bool SQLDatabase::generateMatches(const SQLSyntheticDataset& _dataset) {
+	if (!isOpen()) return false;
+
+	if (matchCount() != 0) {
+		qDebug() << "SQLDatabase::generateMatches: the database already has matches, not generating any";
+
+		return false;
+	}
+
+	SQLSyntheticDataset dataset(_dataset);
+	dataset.reset();
+
+	foreach (const QString& attr, QStringList() << "status") {
+		if (!matchHasRealField(attr)) addMatchField(attr, "INTEGER", "0");
+	}
+
+	foreach (const QString& attr, QStringList() << "error" << "overlap" << "volume" << "old_volume" << "probability") {
+		if (!matchHasRealField(attr)) addMatchField(attr, "REAL", "0");
+	}
+
+	// these are written along with the rest, instead of filled in for every match afterwards
+	if (!matchHasRealField("comment")) addMatchField("comment", "");
+	if (!matchHasRealField("duplicate")) addMatchField("duplicate", 0);
+
+	if (!transaction()) {
+		qDebug() << "SQLDatabase::generateMatches: couldn't start transaction:" << database().lastError();
+
+		return false;
+	}
+
+	SQLImportBatch batch(database(), supports(MULTI_ROW_INSERT), mImportBatchSize);
+	if (mBinaryTransformations) batch.setTransformationColumn(transformationColumn());
+	batch.setMatchColumns(wideMatchFields());
+
+	QElapsedTimer timer;
+	timer.start();
+
+	emit databaseOpStarted(tr("Generating matches"), dataset.matches);
+
+	SQLImportRow row;
+	int duplicate;
+
+	while (dataset.next(row, duplicate)) {
+		batch.addMatch(row.matchId, row.source, row.target, mBinaryTransformations ? QVariant(encodeTransformation(row.xf)) : QVariant(row.transformation));
+
+		batch.addAttribute("status", row.matchId, row.status);
+		batch.addAttribute("error", row.matchId, row.error);
+		batch.addAttribute("overlap", row.matchId, row.overlap);
+		batch.addAttribute("volume", row.matchId, row.volume);
+		batch.addAttribute("old_volume", row.matchId, row.oldVolume);
+		batch.addAttribute("probability", row.matchId, row.probability);
+		batch.addAttribute("comment", row.matchId, QString(""));
+		batch.addAttribute("duplicate", row.matchId, duplicate);
+
+		if (batch.isFull() && !batch.flush()) {
+			qDebug() << "SQLDatabase::generateMatches: could not insert batch ending at match" << row.matchId << ", rolling back";
+
+			database().rollback();
+
+			emit databaseOpEnded();
+
+			return false;
+		}
+
+		if (row.matchId % 1000 == 0) emit databaseOpStepDone(row.matchId);
+	}
+
+	if (!batch.flush() || !commit()) {
+		qDebug() << "SQLDatabase::generateMatches: could not insert the last batch, rolling back:" << database().lastError();
+
+		database().rollback();
+
+		emit databaseOpEnded();
+
+		return false;
+	}
+
+	const qint64 elapsed = qMax(qint64(1), timer.elapsed());
+
+	qDebug() << "SQLDatabase::generateMatches: generated" << dataset.matches << "matches," << batch.rowsWritten() << "rows in" << elapsed << "msec ="
+		<< (batch.rowsWritten() * 1000 / elapsed) << "rows/sec";
+
+	emit databaseOpEnded();
+
+	// like stressTestFromXML(), num_duplicates is added once duplicate is filled so its triggers don't run for every row
+	addMetaMatchField(NUM_DUPLICATES_FIELD, NUM_DUPLICATES_QUERY);
+	materializeMetaAttributes();
+
+	mAttributeCache.clear();
+	clearCountCache();
+	++mModificationCount;
+	emit matchCountChanged();
+
+	return true;
+}
+
+void SQLDatabase::saveToXML(const QString& XMLFile) {
+	if (XMLFile == "") {
+		qDebug("SQLDatabase::saveToXML: filename was empty, aborting...");
+
+		return;
+	}
+
+	QFile file(XMLFile);
+
+	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		QTextStream out(&file);
+		QDomDocument doc(toXML());
+
+		doc.save(out, 1);
+		file.close();
+	}
+	else {
+		qDebug() << "SQLDatabase::saveToXML: Could not open"  << XMLFile;
+	}
+}
+
+bool SQLDatabase::addMatchField(const QString& name, double defaultValue) {
+	if (addMatchField(name, "REAL", defaultValue)) {
+		emit matchFieldsChanged();
+
+		return true;
+	}
+
+	return false;
+}
+
+bool SQLDatabase::addMatchField(const QString& name, const QString& defaultValue) {
+	if (addMatchField(name, "TEXT", defaultValue)) {
+		emit matchFieldsChanged();
+
+		return true;
+	}
+
+	return false;
+}
+
+bool SQLDatabase::addMatchField(const QString& name, int defaultValue) {
+	if (addMatchField(name, "INTEGER", defaultValue)) {
+		emit matchFieldsChanged();
+
+		return true;
+	}
+
+	return false;
+}
+
+template<typename T> bool SQLDatabase::addMatchField(const QString& name, const QString& sqlType, T defaultValue, bool indexValue) {
+	if (matchHasField(name)) {
+		qDebug() << "SQLDatabase::addMatchField: field" << name << "already exists";
+
+		return false;
+	}
+
+	if (!isOpen()) {
+		qDebug() << "SQLDatabase::addMatchField: database wasn't open";
+
+		return false;
+	}
+
+	stopAsync();
+
+	bool success = false;
+
+	QSqlDatabase db = database();
+	QSqlQuery query(db);
+
+	if (!transaction()) {
+		qDebug() << "SQLDatabase::addMatchField: could NOT start a transaction, the following might be very slow";
+	}
+
+	/*
+	if (query.exec("START TRANSACTION")) qDebug() << "SQLDatabase::addMatchField: Correctly manually started a transaction";
+	else qDebug() << "SQLDatabase::addMatchField can't start transaction:" << query.lastError();
+
+	if (query.exec("BEGIN")) qDebug() << "SQLDatabase::addMatchField: Correctly manually started a transaction";
+	else qDebug() << "SQLDatabase::addMatchField can't start transaction:" << query.lastError();
+	*/
+
+	// text defaults have to be quoted
+	QSqlField defaultField(name, QVariant(defaultValue).type());
+	defaultField.setValue(defaultValue);
+	const QString defaultSql = db.driver()->formatValue(defaultField);
+
+	if (attributeLayout() == WideLayout && fitsWideLayout(name, sqlType)) {
+		// the rows of matches get the default value right away, no need to insert anything
+		success = query.exec(QString("ALTER TABLE matches ADD COLUMN %1 %2 DEFAULT %3").arg(name).arg(sqlType).arg(defaultSql));
+
+		if (success && setSetting(WIDE_FIELDS_SETTING, (wideMatchFields() << name).join(","))) {
+			commit();
+
+			// building the index after the column is in place is cheaper than keeping it up to date
+			if (indexValue) {
+				createSortIndex("matches", name);
+			}
+
+			qDebug() << "SQLDatabase::addMatchField succesfully created column:" << name;
+
+			return true;
+		}
+
+		qDebug() << "SQLDatabase::addMatchField couldn't create column:" << query.lastError()
+			<< "\nQuery executed:" << query.lastQuery();
+
+		database().rollback();
+
+		// MySQL commits implicitly after DDL, so the column might be there anyway
+		if (tableFields("matches").contains(name) && !query.exec(QString("ALTER TABLE matches DROP COLUMN %1").arg(name))) {
+			qDebug() << "SQLDatabase::addMatchField: couldn't drop the column again:" << query.lastError();
+		}
+
+		return false;
+	}
+
+	success = query.exec(QString("CREATE TABLE %1 (match_id INTEGER PRIMARY KEY AUTOINCREMENT, %1 %2 NOT NULL DEFAULT %3, confidence REAL NOT NULL DEFAULT 1)").arg(name).arg(sqlType).arg(defaultSql));
+	if (success) {
+		// insert the default value everywhere, in one statement instead of one per match
+		QElapsedTimer timer;
+		timer.start();
+
+		query.prepare(QString(
+			"INSERT INTO %1 (match_id, %1, confidence) "
+			"SELECT match_id, ?, 1 FROM matches"
+		).arg(name));
+		query.addBindValue(defaultValue);
+
+		if (query.exec()) {
+			qDebug() << "SQLDatabase::addMatchField: inserted" << query.numRowsAffected() << "default values in" << timer.elapsed() << "msec";
+		}
+		else {
+			qDebug() << "SQLDatabase::addMatchField couldn't create default values:" << query.lastError()
+				<< "\nQuery executed:" << query.lastQuery();
+
+			// a table without the rows would hide the matches from every query that joins it
+			success = false;
+		}
+	}
+	else {
+		qDebug() << "SQLDatabase::addMatchField couldn't create table:" << query.lastError()
+			<< "\nQuery executed:" << query.lastQuery();
+	}
+
+	if (!success) {
+		database().rollback();
+
+		// MySQL commits implicitly after DDL, an empty table would be left behind
+		if (tables().contains(name) && !query.exec(QString("DROP TABLE %1").arg(name))) {
+			qDebug() << "SQLDatabase::addMatchField: couldn't drop the table again:" << query.lastError();
+		}
+
+		return false;
+	}
+
+	commit();
+
+	// building the index after the fill is cheaper than keeping it up to date during the fill
+	if (indexValue) {
+		createSortIndex(name, name);
+	}
+
+	qDebug() << "SQLDatabase::addMatchField succesfully created field:" << name;
+
+	return true;
+}
+
+/**
+ * @param name
+ * 		The name of the new attribute
+ * @param sql
+ * 		SQL code to create the view which will create a VIEW that can serve as a regular attribute
+ */
+bool SQLDatabase::addMetaMatchField(const QString& name, const QString& sql) {
+	sync();
+	stopAsync();
+
+	if (matchHasField(name)) {
+		qDebug() << "SQLDatabase::addMetaMatchField: field" << name << "already exists";
+
+		return false;
+	}
+
+	if (!isOpen()) {
+		qDebug() << "SQLDatabase::addMatchField: database wasn't open";
+
+		return false;
+	}
+
+	bool success = false;
+
+	QSqlDatabase db = database();
+	QSqlQuery query(db);
+
+	transaction();
+	success = query.exec(createViewQuery(name, sql));
+	//success = query.exec(QString("CREATE VIEW IF NOT EXISTS %1 AS %2").arg(name).arg(sql));
+	if (success) {
+		qDebug() << "SQLDatabase::addMetaMatchField: Create view appears to have been succesful, query:" << query.lastQuery();
+		emit matchFieldsChanged();
+	}
+	else {
+		qDebug() << "SQLDatabase::addMetaMatchField: couldn't create VIEW table:" << query.lastError()
+			<< "\nQuery executed:" << query.lastQuery();
+	}
+	commit();
+
+	return success;
+}
+
+bool SQLDatabase::removeMatchField(const QString& name) {
+	sync();
+	stopAsync();
+
+	if (!matchHasField(name)) {
+		qDebug() << "SQLDatabase::removeMatchField: field" << name << "doesn't exist";
+
+		return false;
+	}
+
+	if (!isOpen()) {
+		qDebug() << "SQLDatabase::removeMatchField: database wasn't open";
+
+		return false;
+	}
+
+	// this seems to be necessary for the database table to become "unlocked"
+	// even though the queries that we are delete'ing here have in fact had
+	// finish() called on them. Anyway, it's not really a big deal.
+	//
+	// relevant SQL(ite) error if this line is skipped: QSqlError(6, "Unable to fetch row", "database table is locked")
+	resetQueries();
+
+	QSqlDatabase db(database());
+	QSqlQuery query(db);
+	QString queryString;
+	bool wide = false;
+
+	// a materialized meta-attribute takes its triggers with it
+	if (materializedMetaAttributes().contains(name)) {
+		foreach (const QString& event, QStringList() << "insert" << "update" << "delete") {
+			foreach (const QString& drop, dropTriggerQueries(QString("%1_on_%2").arg(name).arg(event), "duplicate")) {
+				if (!query.exec(drop)) qDebug() << "SQLDatabase::removeMatchField: couldn't drop trigger:" << query.lastError() << "\nQuery executed:" << query.lastQuery();
+			}
+		}
+
+		QStringList materialized = materializedMetaAttributes();
+		materialized.removeAll(name);
+		setSetting(MATERIALIZED_SETTING, materialized.join(","));
+
+		queryString = QString("DROP TABLE %1").arg(name);
+	}
+	else if (mWideMatchFields.contains(name)) wide = true;
+	else if (mNormalMatchFields.contains(name)) queryString = QString("DROP TABLE %1").arg(name);
+	else if (mViewMatchFields.contains(name)) queryString = QString("DROP VIEW %1").arg(name);
+	else qDebug() << "SQLDatabase::removeMatchField: this should never have happened!";
+
+	// whatever kind of attribute it was, its indexes go with it
+	QStringList indexed = setting(SORT_INDEXES_SETTING).split(",", QString::SkipEmptyParts);
+	if (indexed.removeAll(name) > 0) setSetting(SORT_INDEXES_SETTING, indexed.join(","));
+
+	transaction();
+	if (wide) {
+		QStringList fields = wideMatchFields();
+		fields.removeAll(name);
+
+		if (dropColumn("matches", name) && setSetting(WIDE_FIELDS_SETTING, fields.join(","))) emit matchFieldsChanged();
+	}
+	else if (!query.exec(queryString)) {
+		qDebug() << "SQLDatabase::removeMatchField couldn't drop table:" << query.lastError()
+				<< "\nQuery executed:" << query.lastQuery();
+	}
+	else {
+		emit matchFieldsChanged();
+	}
+	commit();
+
+	return true;
+}
+
+QString SQLDatabase::extUuid() {
+	static QString extUuid;
+
+	if (extUuid.size() == 0) {
+		QString name(QCoreApplication::applicationName());
+		if (!name.size())  name = "anonymous";  // so it doesn't start with a dot
+		//extUuid = name + "_" + QUuid::createUuid().toString();
+		qsrand(QTime::currentTime().msec());
+		extUuid = name.toLower() + "_" + QString::number(qrand());
+	}
+
+	return extUuid;
+}
+
+void SQLDatabase::setOptions(SQLDatabase::Options options) {
+	mOptions = options;
+
+	qDebug() << "SQLDatabase::setOptions: options changed, now:" << mOptions;
+}
+
+void SQLDatabase::setOption(SQLDatabase::Option option, bool enable) {
+	if (enable)
+		mOptions |= option;
+	else
+		mOptions &= ~option;
+
+	qDebug() << "SQLDatabase::setOption: options changed" << option << "->" << enable << ", now:" << mOptions;
+}
+
+SQLDatabase::Options SQLDatabase::options() const {
+	return mOptions;
+}
+
+int SQLDatabase::getNumberOfMatches(const SQLFilter& filter) const {
+	sync();
+
+	const QString key = filter.normalizedClauses();
+	const QSet<QString> dependencies = filter.dependencies().toSet();
+
+	int count = 0;
+	if (cachedNumberOfMatches(key, count)) return count;
+
+	int generation;
+
+	{
+		QMutexLocker locker(&mCountMutex);
+
+		generation = mCountGeneration;
+	}
+
+	// filters on status alone can be answered from the histogram, and kept up to date through it
+	if (dependencies.size() == 1 && dependencies.contains(STATUS_FIELD)) {
+		QList<int> statuses;
+
+		if (matchingStatuses(filter, statuses)) {
+			QMutexLocker locker(&mCountMutex);
+
+			if (mStatusHistogramValid) {
+				CachedCount c;
+				c.count = 0;
+				c.dependencies = dependencies;
+				c.statusOnly = true;
+				c.statuses = statuses;
+
+				mCountCache.insert(key, c);
+
+				foreach (int status, statuses) count += mStatusHistogram.value(status);
+
+				return count;
+			}
+		}
+	}
+
+	QString queryString = "SELECT Count(matches.match_id) FROM matches";
+
+	//join in dependencies, the wide ones are columns of matches already
+	foreach (const QString& field, dependencies) {
+		if (!mWideMatchFields.contains(field)) queryString += QString(" INNER JOIN %1 ON matches.match_id = %1.match_id").arg(field);
+	}
+
+	// add filter clauses
+	const QStringList clauses = filter.clauses() + notNullClauses(dependencies);
+
+	if (!clauses.isEmpty()) {
+		queryString += " WHERE (" + clauses.join(") AND (") + ")";
+	}
+
+	QSqlQuery query(database());
+	if (query.exec(queryString) && query.first()) {
+		count = query.value(0).toInt();
+
+		QMutexLocker locker(&mCountMutex);
+
+		// if something was written in the meantime, the count might already be outdated
+		if (generation == mCountGeneration) {
+			CachedCount c;
+			c.count = count;
+			c.dependencies = dependencies;
+			c.statusOnly = false;
+
+			mCountCache.insert(key, c);
+		}
+
+		return count;
+	}
+	else {
+		qDebug() << "SQLDatabase::getNumberOfMatches: problem with query:" << query.lastError();
+
+		return 0;
+	}
+}
+
+int SQLDatabase::estimateNumberOfMatches(const SQLFilter& filter, bool *exact) const {
+	int count = 0;
+
+	if (cachedNumberOfMatches(filter.normalizedClauses(), count)) {
+		if (exact) *exact = true;
+
+		return count;
+	}
+
+	if (exact) *exact = false;
+
+	// the total is only counted once, after that it stays cached until matches are added
+	return getNumberOfMatches(SQLFilter());
+}
+
+bool SQLDatabase::cachedNumberOfMatches(const QString& key, int& count) const {
+	QMutexLocker locker(&mCountMutex);
+
+	QHash<QString, CachedCount>::iterator i = mCountCache.find(key);
+
+	if (i == mCountCache.end()) return false;
+
+	if (i.value().statusOnly) {
+		if (!mStatusHistogramValid) {
+			mCountCache.erase(i);
+
+			return false;
+		}
+
+		count = 0;
+		foreach (int status, i.value().statuses) count += mStatusHistogram.value(status);
+	}
+	else {
+		count = i.value().count;
+	}
+
+	return true;
+}
+
+bool SQLDatabase::matchingStatuses(const SQLFilter& filter, QList<int>& statuses) const {
+	QList<int> values;
+	int generation;
+
+	{
+		QMutexLocker locker(&mCountMutex);
+
+		generation = mCountGeneration;
+		if (mStatusHistogramValid) values = mStatusHistogram.keys();
+	}
+
+	if (values.isEmpty()) {
+		QSqlQuery query(database());
+		QHash<int, int> histogram;
+
+		if (!query.exec(QString("SELECT %1, Count(match_id) FROM %2 WHERE %1 IS NOT NULL GROUP BY %1").arg(STATUS_FIELD).arg(fieldTable(STATUS_FIELD)))) {
+			qDebug() << "SQLDatabase::matchingStatuses: could not make the status histogram:" << query.lastError();
+
+			return false;
+		}
+
+		while (query.next()) {
+			histogram.insert(query.value(0).toInt(), query.value(1).toInt());
+		}
+
+		QMutexLocker locker(&mCountMutex);
+
+		if (generation != mCountGeneration) return false;
+
+		mStatusHistogram = histogram;
+		mStatusHistogramValid = true;
+
+		values = histogram.keys();
+	}
+
+	statuses.clear();
+
+	// nothing has a status yet, so nothing matches (when a status appears, the status-only counts are dropped)
+	if (values.isEmpty()) return true;
+
+	// evaluate the filter on every status that occurs, the derived table stands in for the status table
+	QStringList rows;
+	foreach (int value, values) {
+		rows << QString("SELECT %1 AS %2").arg(value).arg(STATUS_FIELD);
+	}
+
+	QSqlQuery query(database());
+
+	if (!query.exec(QString("SELECT %1 FROM (%2) AS %1 WHERE (%3)").arg(STATUS_FIELD).arg(rows.join(" UNION ALL ")).arg(filter.clauses().join(") AND (")))) {
+		// the filter probably refers to something else than status, like the names of the fragments
+		qDebug() << "SQLDatabase::matchingStatuses: filter can't be evaluated on status alone:" << query.lastError();
+
+		return false;
+	}
+
+	while (query.next()) {
+		statuses << query.value(0).toInt();
+	}
+
+	return true;
+}
+
+bool SQLDatabase::maintainsStatusCounts() const {
+	QMutexLocker locker(&mCountMutex);
+
+	return mStatusHistogramValid;
+}
+
+void SQLDatabase::clearCountCache() const {
+	QMutexLocker locker(&mCountMutex);
+
+	++mCountGeneration;
+
+	mCountCache.clear();
+	mStatusHistogram.clear();
+	mStatusHistogramValid = false;
+}
+
+void SQLDatabase::updateCountCache(const QString& field, const QVariant& oldValue, const QVariant& newValue) {
+	QMutexLocker locker(&mCountMutex);
+
+	++mCountGeneration;
+
+	bool newStatus = false;
+
+	if (field == STATUS_FIELD && mStatusHistogramValid && oldValue.isValid()) {
+		const int status = newValue.toInt();
+
+		newStatus = !mStatusHistogram.contains(status);
+
+		--mStatusHistogram[oldValue.toInt()];
+		++mStatusHistogram[status];
+	}
+	else if (field == STATUS_FIELD && mStatusHistogramValid) {
+		// either the match had no status (then nothing changed) or the histogram got made after the old value was
+		// looked up, there's no telling which, so it will have to be recounted
+		mStatusHistogramValid = false;
+	}
+
+	const QSet<QString> dependentViews = dependentViewFields(field).toSet();
+
+	QMutableHashIterator<QString, CachedCount> i(mCountCache);
+	while (i.hasNext()) {
+		const CachedCount& c = i.next().value();
+
+		if (c.statusOnly) {
+			// a status value that didn't occur before wasn't evaluated against the filter
+			if (newStatus) i.remove();
+		}
+		else if (c.dependencies.contains(field) || !(c.dependencies & dependentViews).isEmpty()) {
+			i.remove();
+		}
+	}
+}
+
+bool SQLDatabase::materializeMetaAttributes() {
+	sync();
+	stopAsync();
+
+	if (!isOpen()) return false;
+
+	const QStringList materialized = materializedMetaAttributes();
+
+	foreach (const QString& field, mViewMatchFields) {
+		if (field != NUM_DUPLICATES_FIELD && !materialized.contains(field)) {
+			qDebug() << "SQLDatabase::materializeMetaAttributes: don't know how to keep" << field << "up to date, it stays a view";
+		}
+	}
+
+	if (!mViewMatchFields.contains(NUM_DUPLICATES_FIELD) || materialized.contains(NUM_DUPLICATES_FIELD)) return true;
+
+	const QString& field = NUM_DUPLICATES_FIELD;
+
+	// changing the duplicate of a match takes one off the count of its old master and adds one to its new master, recounting
+	// would be a lot slower (most matches are in the group of master 0, which means no master)
+	// a master only gets a row when it has duplicates, like in the view, and the row comes from matches so no row is made for 0
+	QStringList decrementOld, incrementNew;
+	decrementOld
+		<< QString("UPDATE %1 SET %1 = %1 - 1 WHERE match_id = OLD.duplicate").arg(field)
+		<< QString("DELETE FROM %1 WHERE match_id = OLD.duplicate AND %1 <= 0").arg(field);
+	incrementNew
+		<< QString("UPDATE %1 SET %1 = %1 + 1 WHERE match_id = NEW.duplicate").arg(field)
+		<< QString("INSERT INTO %1 (match_id, %1) SELECT match_id, 1 FROM matches WHERE match_id = NEW.duplicate AND NOT EXISTS (SELECT match_id FROM %1 WHERE match_id = NEW.duplicate)").arg(field);
+
+	QStringList queries;
+	queries
+		<< QString("DROP VIEW %1").arg(field)
+		<< QString("CREATE TABLE %1 (match_id INTEGER PRIMARY KEY, %1 INTEGER NOT NULL)").arg(field)
+		<< QString("INSERT INTO %1 (match_id, %1) %2").arg(field).arg(NUM_DUPLICATES_QUERY)
+		<< createTriggerQueries(field + "_on_insert", "duplicate", "INSERT", incrementNew)
+		<< createTriggerQueries(field + "_on_update", "duplicate", "UPDATE", decrementOld + incrementNew)
+		<< createTriggerQueries(field + "_on_delete", "duplicate", "DELETE", decrementOld);
+
+	resetQueries();
+
+	QSqlQuery query(database());
+	bool success = true;
+
+	transaction();
+
+	foreach (const QString& queryString, queries) {
+		if (!query.exec(queryString)) {
+			qDebug() << "SQLDatabase::materializeMetaAttributes: couldn't materialize" << field << ":" << query.lastError()
+				<< "\nQuery executed:" << query.lastQuery();
+
+			success = false;
+
+			break;
+		}
+	}
+
+	if (!success) {
+		database().rollback();
+
+		// MySQL commits implicitly after DDL, so the view might be gone anyway
+		if (!tables(QSql::Views).contains(field)) {
+			foreach (const QString& event, QStringList() << "insert" << "update" << "delete") {
+				foreach (const QString& drop, dropTriggerQueries(QString("%1_on_%2").arg(field).arg(event), "duplicate")) query.exec(drop);
+			}
+
+			query.exec(QString("DROP TABLE %1").arg(field));
+			query.exec(createViewQuery(field, NUM_DUPLICATES_QUERY));
+		}
+
+		return false;
+	}
+
+	commit();
+
+	setSetting(MATERIALIZED_SETTING, (materialized + QStringList(field)).join(","));
+	createSortIndex(field, field);
+
+	qDebug() << "SQLDatabase::materializeMetaAttributes: materialized" << field;
+
+	emit matchFieldsChanged();
+
+	return true;
+}
+
+QStringList SQLDatabase::materializedMetaAttributes() const {
+	return setting(MATERIALIZED_SETTING).split(",", QString::SkipEmptyParts);
+}
+
+QStringList SQLDatabase::createTriggerQueries(const QString& name, const QString& table, const QString& event, const QStringList& statements) const {
+	return dropTriggerQueries(name, table)
+		<< QString("CREATE TRIGGER %1 AFTER %2 ON %3 FOR EACH ROW BEGIN %4; END").arg(name).arg(event).arg(table).arg(statements.join("; "));
+}
+
+QStringList SQLDatabase::dropTriggerQueries(const QString& name, const QString&) const {
+	return QStringList() << QString("DROP TRIGGER IF EXISTS %1").arg(name);
+}
+
+QString SQLDatabase::dropTemporaryTableQuery(const QString& table) const {
+	return QString("DROP TABLE IF EXISTS %1").arg(table);
+}
+
+SQLDatabase::AttributeLayout SQLDatabase::attributeLayout() const {
+	return (setting(LAYOUT_SETTING) == "wide") ? WideLayout : TableLayout;
+}
+
+bool SQLDatabase::setAttributeLayout(SQLDatabase::AttributeLayout layout) {
+	sync();
+	stopAsync();
+
+	if (!isOpen()) return false;
+
+	if (!setSetting(LAYOUT_SETTING, (layout == WideLayout) ? "wide" : "tables")) return false;
+
+	const QStringList fields = (layout == WideLayout) ? (mNormalMatchFields - mWideMatchFields).toList() : mWideMatchFields.toList();
+
+	// the prepared queries refer to the tables and columns that are about to disappear
+	resetQueries();
+
+	bool success = true;
+	int step = 0;
+
+	emit databaseOpStarted(tr("Migrating attributes"), fields.size());
+
+	foreach (const QString& field, fields) {
+		if (layout == WideLayout) {
+			const QString type = columnSqlType(database().record(field).field(field).type());
+
+			if (fitsWideLayout(field, type)) success = moveToWideLayout(field, type);
+		}
+		else {
+			success = moveToTableLayout(field, columnSqlType(database().record("matches").field(field).type()));
+		}
+
+		if (!success) break;
+
+		emit databaseOpStepDone(++step);
+	}
+
+	emit databaseOpEnded();
+
+	// picks up the new layout and makes history tables for whatever doesn't have one yet
+	emit matchFieldsChanged();
+
+	return success;
+}
+
+bool SQLDatabase::moveToWideLayout(const QString& field, const QString& sqlType) {
+	QStringList queries;
+
+	// the matches that didn't have a row get NULL, which is how wide attributes say that
+	queries
+		<< QString("ALTER TABLE matches ADD COLUMN %1 %2").arg(field).arg(sqlType)
+		<< QString("UPDATE matches SET %1 = (SELECT %1.%1 FROM %1 WHERE %1.match_id = matches.match_id)").arg(field)
+		<< QString("DROP TABLE %1").arg(field);
+
+	QSqlQuery query(database());
+
+	transaction();
+
+	foreach (const QString& queryString, queries) {
+		if (!query.exec(queryString)) {
+			qDebug() << "SQLDatabase::moveToWideLayout: couldn't move" << field << "into matches:" << query.lastError()
+				<< "\nQuery executed:" << query.lastQuery();
+
+			database().rollback();
+
+			return false;
+		}
+	}
+
+	if (!setSetting(WIDE_FIELDS_SETTING, (wideMatchFields() << field).join(","))) {
+		database().rollback();
 
 		return false;
 	}
 
-	bool success = false;
+	commit();
 
-	QSqlDatabase db = database();
-	QSqlQuery query(db);
+	createSortIndex("matches", field);
+
+	qDebug() << "SQLDatabase::moveToWideLayout: moved" << field << "into matches";
+
+	return true;
+}
+
+bool SQLDatabase::moveToTableLayout(const QString& field, const QString& sqlType) {
+	QSqlQuery query(database());
 
 	transaction();
-	success = query.exec(createViewQuery(name, sql));
-	//success = query.exec(QString("CREATE VIEW IF NOT EXISTS %1 AS %2").arg(name).arg(sql));
-	if (success) {
-		qDebug() << "SQLDatabase::addMetaMatchField: Create view appears to have been succesful, query:" << query.lastQuery();
-		emit matchFieldsChanged();
-	}
-	else {
-		qDebug() << "SQLDatabase::addMetaMatchField: couldn't create VIEW table:" << query.lastError()
+
+	const bool success =
+		query.exec(QString("CREATE TABLE %1 (match_id INTEGER PRIMARY KEY AUTOINCREMENT, %1 %2 NOT NULL DEFAULT 0, confidence REAL NOT NULL DEFAULT 1)").arg(field).arg(sqlType)) &&
+		query.exec(QString("INSERT INTO %1 (match_id, %1) SELECT match_id, %1 FROM matches WHERE %1 IS NOT NULL").arg(field));
+
+	if (!success) {
+		qDebug() << "SQLDatabase::moveToTableLayout: couldn't move" << field << "out of matches:" << query.lastError()
 			<< "\nQuery executed:" << query.lastQuery();
 	}
+
+	QStringList fields = wideMatchFields();
+	fields.removeAll(field);
+
+	if (!success || !dropColumn("matches", field) || !setSetting(WIDE_FIELDS_SETTING, fields.join(","))) {
+		database().rollback();
+
+		return false;
+	}
+
 	commit();
 
-	return success;
+	// the index on the column went with it, so the name is free again
+	createSortIndex(field, field);
+
+	qDebug() << "SQLDatabase::moveToTableLayout: moved" << field << "out of matches";
+
+	return true;
 }
 
-bool SQLDatabase::removeMatchField(const QString& name) {
-	if (!matchHasField(name)) {
-		qDebug() << "SQLDatabase::removeMatchField: field" << name << "doesn't exist";
+QStringList SQLDatabase::wideMatchFields() const {
+	return setting(WIDE_FIELDS_SETTING).split(",", QString::SkipEmptyParts);
+}
+
+bool SQLDatabase::fitsWideLayout(const QString& field, const QString& sqlType) {
+	// num_duplicates (the view as well as the triggers of the materialized version) is defined on the duplicate table
+	return sqlType != "TEXT" && field != "duplicate";
+}
+
+QString SQLDatabase::columnSqlType(QVariant::Type type) {
+	switch (type) {
+		case QVariant::Bool:
+		case QVariant::Int:
+		case QVariant::UInt:
+		case QVariant::LongLong:
+		case QVariant::ULongLong:
+			return "INTEGER";
+
+		case QVariant::Double:
+			return "REAL";
+
+		default:
+			return "TEXT";
+	}
+}
+
+bool SQLDatabase::dropColumn(const QString& table, const QString& column) {
+	QSqlQuery query(database());
+
+	// MySQL and PostgreSQL drop the indexes on the column along with it
+	if (!query.exec(QString("ALTER TABLE %1 DROP COLUMN %2").arg(table).arg(column))) {
+		qDebug() << "SQLDatabase::dropColumn: couldn't drop" << column << "from" << table << ":" << query.lastError();
 
 		return false;
 	}
 
-	if (!isOpen()) {
-		qDebug() << "SQLDatabase::removeMatchField: database wasn't open";
+	return true;
+}
+
+QString SQLDatabase::historyTemplateQuery(const QString& field) const {
+	if (mWideMatchFields.contains(field)) return QString("SELECT match_id, %1 FROM matches WHERE 1=2").arg(field);
+
+	return QString("SELECT * FROM %1 WHERE 1=2").arg(field);
+}
+
+QStringList SQLDatabase::notNullClauses(const QSet<QString>& fields) const {
+	QStringList clauses;
+
+	foreach (const QString& field, fields) {
+		if (mWideMatchFields.contains(field)) clauses << QString("matches.%1 IS NOT NULL").arg(field);
+	}
+
+	return clauses;
+}
+
+int SQLDatabase::schemaVersion() const {
+	return setting("schema_version", "1").toInt();
+}
+
+bool SQLDatabase::hasBinaryTransformations() const {
+	return mBinaryTransformations;
+}
+
+QString SQLDatabase::transformationColumn() const {
+	return mBinaryTransformations ? "transformation_bin" : "transformation";
+}
+
+void SQLDatabase::readSettings() {
+	mBinaryTransformations = schemaVersion() >= BINARY_TRANSFORMATIONS_SCHEMA_VERSION && tableFields("matches").contains("transformation_bin");
+
+	qDebug() << "SQLDatabase::readSettings: schema version" << schemaVersion() << "->" << (mBinaryTransformations ? "binary" : "text") << "transformations";
+}
+
+QString SQLDatabase::setting(const QString& name, const QString& deflt) const {
+	if (!tables().contains("settings")) return deflt;
+
+	QSqlQuery query(database());
+	query.prepare("SELECT value FROM settings WHERE name = :name");
+	query.bindValue(":name", name);
+
+	if (query.exec() && query.next()) {
+		return query.value(0).toString();
+	}
+
+	return deflt;
+}
+
+bool SQLDatabase::setSetting(const QString& name, const QString& value) {
+	QSqlQuery query(database());
+
+	if (!tables().contains("settings") && !query.exec("CREATE TABLE settings (name VARCHAR(64) PRIMARY KEY, value TEXT)")) {
+		qDebug() << "SQLDatabase::setSetting: could not create the settings table:" << query.lastError();
 
 		return false;
 	}
 
-	// this seems to be necessary for the database table to become "unlocked"
-	// even though the queries that we are delete'ing here have in fact had
-	// finish() called on them. Anyway, it's not really a big deal.
-	//
-	// relevant SQL(ite) error if this line is skipped: QSqlError(6, "Unable to fetch row", "database table is locked")
-	resetQueries();
+	query.prepare("DELETE FROM settings WHERE name = :name");
+	query.bindValue(":name", name);
+
+	if (!query.exec()) {
+		qDebug() << "SQLDatabase::setSetting: could not remove the old value of" << name << ":" << query.lastError();
+
+		return false;
+	}
+
+	query.prepare("INSERT INTO settings (name, value) VALUES (:name, :value)");
+	query.bindValue(":name", name);
+	query.bindValue(":value", value);
+
+	if (!query.exec()) {
+		qDebug() << "SQLDatabase::setSetting: could not store" << name << "=" << value << ":" << query.lastError();
+
+		return false;
+	}
+
+	return true;
+}
+
+bool SQLDatabase::convertTransformations(bool toBinary) {
+	sync();
+
+	if (!isOpen()) return false;
+	if (toBinary == mBinaryTransformations) return true;
 
 	QSqlDatabase db(database());
 	QSqlQuery query(db);
-	QString queryString;
 
-	if (mNormalMatchFields.contains(name)) queryString = QString("DROP TABLE %1").arg(name);
-	else if (mViewMatchFields.contains(name)) queryString = QString("DROP VIEW %1").arg(name);
-	else qDebug() << "SQLDatabase::removeMatchField: this should never have happened!";
+	// the binary column is never dropped again, converting back to text just empties it
+	if (!tableFields("matches").contains("transformation_bin")) {
+		if (!query.exec(QString("ALTER TABLE matches ADD COLUMN transformation_bin %1").arg(blobSqlType()))) {
+			qDebug() << "SQLDatabase::convertTransformations: could not add the binary transformation column:" << query.lastError();
+
+			return false;
+		}
+	}
+
+	const QString from = toBinary ? "transformation" : "transformation_bin";
+	const QString to = toBinary ? "transformation_bin" : "transformation";
+
+	// walk the matches table in chunks by match_id, updating every chunk in one batch
+	const int chunkSize = 5000;
+
+	QSqlQuery select(db);
+	select.setForwardOnly(true);
+	select.prepare(QString("SELECT match_id, %1 FROM matches WHERE match_id > :last ORDER BY match_id LIMIT %2").arg(from).arg(chunkSize));
+
+	QSqlQuery update(db);
+	update.prepare(QString("UPDATE matches SET %1 = ?, %2 = NULL WHERE match_id = ?").arg(to).arg(from));
+
+	emit databaseOpStarted(toBinary ? tr("Converting transformations to binary") : tr("Converting transformations to text"), matchCount());
 
 	transaction();
-	if (!query.exec(queryString)) {
-		qDebug() << "SQLDatabase::removeMatchField couldn't drop table:" << query.lastError()
-				<< "\nQuery executed:" << query.lastQuery();
+
+	bool succes = true;
+	int lastId = -1;
+	int converted = 0;
+
+	forever {
+		select.bindValue(":last", lastId);
+
+		if (!select.exec()) {
+			qDebug() << "SQLDatabase::convertTransformations: could not read transformations:" << select.lastError();
+
+			succes = false;
+			break;
+		}
+
+		QVariantList values;
+		QVariantList ids;
+
+		while (select.next()) {
+			XF xf;
+
+			if (toBinary) {
+				QTextStream ts(select.value(1).toString().toAscii());
+				ts >> xf;
+
+				values << encodeTransformation(xf);
+			}
+			else {
+				decodeTransformation(select.value(1).toByteArray(), xf);
+
+				values << transformationToString(xf);
+			}
+
+			lastId = select.value(0).toInt();
+			ids << lastId;
+		}
+
+		select.finish();
+
+		if (ids.isEmpty()) break;
+
+		update.addBindValue(values);
+		update.addBindValue(ids);
+
+		if (!update.execBatch()) {
+			qDebug() << "SQLDatabase::convertTransformations: could not write transformations:" << update.lastError();
+
+			succes = false;
+			break;
+		}
+
+		converted += ids.size();
+
+		emit databaseOpStepDone(converted);
+	}
+
+	succes = succes && setSetting("schema_version", QString::number(toBinary ? BINARY_TRANSFORMATIONS_SCHEMA_VERSION : 1));
+
+	if (succes && commit()) {
+		mBinaryTransformations = toBinary;
+
+		qDebug() << "SQLDatabase::convertTransformations: converted" << converted << "transformations to" << to;
 	}
 	else {
-		emit matchFieldsChanged();
+		qDebug() << "SQLDatabase::convertTransformations: conversion failed, rolling back";
+
+		db.rollback();
+		succes = false;
 	}
-	commit();
 
-	return true;
+	emit databaseOpEnded();
+
+	return succes;
 }
 
-QString SQLDatabase::extUuid() {
-	static QString extUuid;
+bool SQLDatabase::updateAttribute(const QString& field, const QVariant& value, const SQLFilter& filter) {
+	if (!matchHasRealField(field)) {
+		qDebug() << "SQLDatabase::updateAttribute: field" << field << "doesn't exist or isn't a real attribute";
 
-	if (extUuid.size() == 0) {
-		QString name(QCoreApplication::applicationName());
-		if (!name.size())  name = "anonymous";  // so it doesn't start with a dot
-		//extUuid = name + "_" + QUuid::createUuid().toString();
-		qsrand(QTime::currentTime().msec());
-		extUuid = name.toLower() + "_" + QString::number(qrand());
+		return false;
 	}
 
-	return extUuid;
-}
+	// the queued writes come first
+	sync();
 
-void SQLDatabase::setOptions(SQLDatabase::Options options) {
-	mOptions = options;
+	// joining in the attribute itself leaves out the matches that don't have it
+	QSet<QString> dependencies = filter.dependencies().toSet();
+	dependencies << field;
 
-	qDebug() << "SQLDatabase::setOptions: options changed, now:" << mOptions;
-}
+	QString ids = "SELECT matches.match_id FROM matches";
 
-void SQLDatabase::setOption(SQLDatabase::Option option, bool enable) {
-	if (enable)
-		mOptions |= option;
-	else
-		mOptions &= ~option;
+	foreach (const QString& dependency, dependencies) {
+		if (!mWideMatchFields.contains(dependency)) ids += QString(" INNER JOIN %1 ON matches.match_id = %1.match_id").arg(dependency);
+	}
 
-	qDebug() << "SQLDatabase::setOption: options changed" << option << "->" << enable << ", now:" << mOptions;
-}
+	// a wide attribute that is NULL counts as missing, like a match without a row in the attribute's table
+	const QStringList clauses = filter.clauses() + notNullClauses(dependencies);
 
-SQLDatabase::Options SQLDatabase::options() const {
-	return mOptions;
+	if (!clauses.isEmpty()) {
+		ids += " WHERE (" + clauses.join(") AND (") + ")";
+	}
+
+	if (!transaction()) {
+		qDebug() << "SQLDatabase::updateAttribute: couldn't start transaction:" << database().lastError();
+
+		return false;
+	}
+
+	QSqlQuery query(database());
+
+	// the matches are collected up front, the filter might depend on the values that are about to change
+	// and MySQL can't select from the table that's being updated in the UPDATE itself (error 1093)
+	bool succes = query.exec(dropTemporaryTableQuery("updated_ids"))
+		&& query.exec("CREATE TEMPORARY TABLE updated_ids (match_id INTEGER PRIMARY KEY)")
+		&& query.exec(QString("INSERT INTO updated_ids (match_id) %1").arg(ids));
+
+	if (!succes) {
+		qDebug() << "SQLDatabase::updateAttribute: couldn't collect the matches to update ->" << query.lastError() << "\n\tQUERY =" << query.lastQuery();
+	}
+
+	if (succes && mTrackHistory) {
+		query.prepare(QString("INSERT INTO %1_history (timestamp, user_id, match_id, %1) SELECT ?, 0, match_id, ? FROM updated_ids").arg(field));
+		query.addBindValue(QDateTime::currentDateTime().toTime_t());
+		query.addBindValue(value.toString());
+
+		if (!query.exec()) {
+			qDebug() << "SQLDatabase::updateAttribute: couldn't write the history of" << field << "->" << query.lastError() << "\n\tQUERY =" << query.lastQuery();
+
+			succes = false;
+		}
+	}
+
+	if (succes) {
+		query.prepare(QString("UPDATE %2 SET %1 = ? WHERE match_id IN (SELECT match_id FROM updated_ids)").arg(field).arg(fieldTable(field)));
+		query.addBindValue(value.toString());
+
+		if (!query.exec()) {
+			qDebug() << "SQLDatabase::updateAttribute: couldn't update" << field << "->" << query.lastError() << "\n\tQUERY =" << query.lastQuery();
+
+			succes = false;
+		}
+		else {
+			qDebug() << "SQLDatabase::updateAttribute: set" << field << "to" << value << "for" << query.numRowsAffected() << "matches";
+		}
+	}
+
+	if (succes) succes = commit();
+	else database().rollback();
+
+	query.exec(dropTemporaryTableQuery("updated_ids"));
+
+	attributeChanged(field);
+
+	return succes;
 }
 
-int SQLDatabase::getNumberOfMatches(const SQLFilter& filter) const {
-	QString queryString = "SELECT Count(matches.match_id) FROM matches";
+bool SQLDatabase::updateAttribute(const QString& field, const QHash<int, QVariant>& values) {
+	if (values.isEmpty()) return true;
 
-	QSet<QString> dependencies = filter.dependencies().toSet();
+	if (!matchHasRealField(field)) {
+		qDebug() << "SQLDatabase::updateAttribute: field" << field << "doesn't exist or isn't a real attribute";
+
+		return false;
+	}
+
+	sync();
+
+	// regrouping duplicates or setting statuses only ever involves a handful of distinct values
+	QMap<QString, QList<int> > byValue;
+
+	for (QHash<int, QVariant>::const_iterator i = values.constBegin(); i != values.constEnd(); ++i) {
+		byValue[i.value().toString()] << i.key();
+	}
+
+	if (!transaction()) {
+		qDebug() << "SQLDatabase::updateAttribute: couldn't start transaction:" << database().lastError();
+
+		return false;
+	}
+
+	QSqlQuery query(database());
+	const QString table = fieldTable(field);
+	// a wide attribute that is NULL counts as missing, like a match without a row in the attribute's table
+	const QString present = mWideMatchFields.contains(field) ? QString(" AND %1 IS NOT NULL").arg(field) : QString();
+	const uint timestamp = QDateTime::currentDateTime().toTime_t();
+	bool succes = true;
+
+	for (QMap<QString, QList<int> >::const_iterator i = byValue.constBegin(); i != byValue.constEnd() && succes; ++i) {
+		const QList<int>& ids = i.value();
+
+		// IN lists are kept to the same size as the ones of the fetch groups
+		for (int begin = 0; begin < ids.size() && succes; begin += FETCH_GROUP_CHUNK_SIZE) {
+			QStringList chunk;
+
+			for (int k = begin; k < qMin(ids.size(), begin + FETCH_GROUP_CHUNK_SIZE); ++k) {
+				chunk << QString::number(ids.at(k));
+			}
+
+			if (mTrackHistory) {
+				query.prepare(QString("INSERT INTO %1_history (timestamp, user_id, match_id, %1) SELECT ?, 0, match_id, ? FROM %2 WHERE match_id IN (%3)%4").arg(field).arg(table).arg(chunk.join(",")).arg(present));
+				query.addBindValue(timestamp);
+				query.addBindValue(i.key());
+
+				if (!query.exec()) {
+					qDebug() << "SQLDatabase::updateAttribute: couldn't write the history of" << field << "->" << query.lastError();
+
+					succes = false;
+				}
+			}
+
+			if (succes) {
+				query.prepare(QString("UPDATE %2 SET %1 = ? WHERE match_id IN (%3)%4").arg(field).arg(table).arg(chunk.join(",")).arg(present));
+				query.addBindValue(i.key());
+
+				if (!query.exec()) {
+					qDebug() << "SQLDatabase::updateAttribute: couldn't update" << field << "->" << query.lastError();
+
+					succes = false;
+				}
+			}
+		}
+	}
+
+	if (succes) succes = commit();
+	else database().rollback();
+
+	attributeChanged(field);
+
+	return succes;
+}
+
+void SQLDatabase::attributeChanged(const QString& field) {
+	mAttributeCache.invalidateField(fieldId(field));
 
-	//join in dependencies
-	foreach (const QString& field, dependencies) {
-		queryString += QString(" INNER JOIN %1 ON matches.match_id = %1.match_id").arg(field);
+	foreach (const QString& viewField, dependentViewFields(field)) {
+		mAttributeCache.invalidateField(fieldId(viewField));
 	}
 
-	// add filter clauses
-	if (!filter.isEmpty()) {
-		queryString += " WHERE (" + filter.clauses().join(") AND (") + ")";
-	}
+	// without the old values the status histogram can't be adjusted
+	clearCountCache();
+	++mModificationCount;
+}
 
-	QSqlQuery query(database());
-	if (query.exec(queryString) && query.first()) {
-		return query.value(0).toInt();
-	}
-	else {
-		qDebug() << "SQLDatabase::getNumberOfMatches: problem with query:" << query.lastError();
+QStringList SQLDatabase::dependentViewFields(const QString& field) const {
+	QStringList dependent;
 
-		return 0;
+	foreach (const QString& viewField, mViewMatchFields) {
+		// the SQL of the others is whatever addMetaMatchField() was given, they could depend on anything
+		if (viewField == NUM_DUPLICATES_FIELD && field != "duplicate") continue;
+
+		dependent << viewField;
 	}
-}
 
-bool SQLDatabase::materializeMetaAttributes() {
-	return false;
+	return dependent;
 }
 
 thera::SQLFragmentConf SQLDatabase::getMatch(int id) {
-	const QString queryString = QString("SELECT matches.match_id, source_name, target_name, transformation FROM matches WHERE match_id = %1").arg(id);
+	sync();
+
+	const QString queryString = QString("SELECT matches.match_id, source_name, target_name, %2 FROM matches WHERE match_id = %1").arg(id).arg(transformationColumn());
 
 	int matchId = -1;
 	SQLDatabase *db = NULL;
@@ -787,8 +2269,13 @@ thera::SQLFragmentConf SQLDatabase::getMatch(int id) {
 
 		assert(matchId == id);
 
-		QTextStream ts(query.value(3).toString().toAscii());
-		ts >> xf;
+		if (mBinaryTransformations) {
+			decodeTransformation(query.value(3).toByteArray(), xf);
+		}
+		else {
+			QTextStream ts(query.value(3).toString().toAscii());
+			ts >> xf;
+		}
 
 		fragments[IFragmentConf::SOURCE] = Database::entryIndex(query.value(1).toString());
 		fragments[IFragmentConf::TARGET] = Database::entryIndex(query.value(2).toString());
@@ -801,6 +2288,8 @@ thera::SQLFragmentConf SQLDatabase::getMatch(int id) {
 }
 
 QList<thera::SQLFragmentConf> SQLDatabase::getMatches(const SQLQueryParameters& _parameters) {
+	sync();
+
 	SQLQueryParameters parameters = _parameters;
 
 	Options options = mOptions;
@@ -855,13 +2344,22 @@ QList<thera::SQLFragmentConf> SQLDatabase::getMatches(const SQLQueryParameters&
 		}
 	}
 
+	// the outer query of a derived table has to sort the encapsulated rows again, so it needs the sort field
+	if (!parameters.preloadMetaFields.isEmpty() && !options.testFlag(UseTemporaryViews) && matchHasField(parameters.sortField) && !parameters.preloadFields.contains(parameters.sortField)) {
+		parameters.preloadFields << parameters.sortField;
+	}
+
 	// TODO: remove the sortField restriction
 	//parameters.forceLateRowLookup = false;
 	queryString = synthesizeQuery(parameters, options);
 
 	// join in the rest if necessary
+	const bool temporaryView = !parameters.preloadMetaFields.isEmpty() && options.testFlag(UseTemporaryViews);
 	QString viewName = "matchopt_" + extUuid();
-	if (!parameters.preloadMetaFields.isEmpty()) {
+
+	// views are shared by all connections, so the other threads each need a name of their own
+	if (QThread::currentThread() != thread()) viewName += "_" + threadSuffix();
+	if (temporaryView) {
 		// create VIEW
 		QElapsedTimer timer;
 		timer.start();
@@ -882,11 +2380,29 @@ QList<thera::SQLFragmentConf> SQLDatabase::getMatches(const SQLQueryParameters&
 			queryString += QString(" LEFT JOIN %1 ON %2.match_id = %1.match_id").arg(field).arg(viewName);
 		}
 	}
+	else if (!parameters.preloadMetaFields.isEmpty()) {
+		// the same as the VIEW, but as a derived table: no DDL, no schema locks and no names to clash
+		queryString = QString("SELECT matchopt.*, %1 FROM (%2) AS matchopt").arg(parameters.preloadMetaFields.join(", ")).arg(queryString);
+
+		foreach (const QString& field, parameters.preloadMetaFields) {
+			queryString += QString(" LEFT JOIN %1 ON matchopt.match_id = %1.match_id").arg(field);
+		}
+
+		// joins don't have to keep the order of the derived table
+		const bool ascending = (parameters.isPaginated) ? ((parameters.order == Qt::AscendingOrder) == parameters.forward) : (parameters.order == Qt::AscendingOrder);
+		const QString order = ascending ? "ASC" : "DESC";
+
+		queryString += " ORDER BY ";
+		if (matchHasField(parameters.sortField)) queryString += QString("matchopt.%1 %2, ").arg(parameters.sortField).arg(order);
+		queryString += QString("matchopt.match_id %1").arg(order);
+	}
 
-	QList<thera::SQLFragmentConf> list = fillFragments(queryString, parameters.preloadFields << parameters.preloadMetaFields);
+	if (QThread::currentThread() == thread()) mLastMatchesQuery = temporaryView ? QString() : queryString;
+
+	QList<thera::SQLFragmentConf> list = fillFragments(queryString, parameters.preloadFields << parameters.preloadMetaFields, parameters.limit);
 
 	// clean-up the temporary view
-	if (!parameters.preloadMetaFields.isEmpty()) {
+	if (temporaryView) {
 		QSqlQuery q(database());
 		if (!q.exec(QString("DROP VIEW IF EXISTS %1;").arg(viewName))) qDebug() << "SQLDatabase::getMatches: couldn't drop view:" << q.lastError();
 	}
@@ -898,9 +2414,105 @@ QList<thera::SQLFragmentConf> SQLDatabase::getMatches(const SQLQueryParameters&
 		}
 	}
 
+	registerFetchGroup(list);
+
 	return list;
 }
 
+void SQLDatabase::registerFetchGroup(const QList<thera::SQLFragmentConf>& list) {
+	// whole resultsets (toXML(), the mergers) aren't windows, the misses of their matches don't predict each other
+	if (list.size() < 2 || list.size() > MAX_FETCH_GROUP_SIZE) return;
+
+	QVector<int> *ids = new QVector<int>;
+	ids->reserve(list.size());
+
+	foreach (const SQLFragmentConf& conf, list) {
+		*ids << conf.index();
+	}
+
+	FetchGroup group(ids);
+
+	QMutexLocker locker(&mFetchGroupMutex);
+
+	// forget the oldest group, but only for the matches that weren't claimed by a newer one
+	if (mFetchGroups.size() >= MAX_FETCH_GROUPS) {
+		FetchGroup oldest = mFetchGroups.dequeue();
+
+		foreach (int id, *oldest) {
+			QHash<int, FetchGroup>::iterator i = mFetchGroupOf.find(id);
+
+			if (i != mFetchGroupOf.end() && i.value() == oldest) mFetchGroupOf.erase(i);
+		}
+	}
+
+	mFetchGroups.enqueue(group);
+
+	foreach (int id, *group) {
+		mFetchGroupOf.insert(id, group);
+	}
+}
+
+bool SQLDatabase::fetchGroupValue(int id, const QString& field, int fieldId, QVariant& value) const {
+	FetchGroup group;
+
+	{
+		QMutexLocker locker(&mFetchGroupMutex);
+
+		group = mFetchGroupOf.value(id);
+	}
+
+	if (group.isNull()) return false;
+
+	// at most one chunk of the matches around id that aren't cached yet, nearest first, so a miss is always one query
+	QList<int> ids;
+	ids << id;
+
+	const int position = group->indexOf(id);
+
+	for (int distance = 1; ids.size() < FETCH_GROUP_CHUNK_SIZE && (position - distance >= 0 || position + distance < group->size()); ++distance) {
+		if (position + distance < group->size() && !mAttributeCache.contains(group->at(position + distance), fieldId)) ids << group->at(position + distance);
+		if (position - distance >= 0 && ids.size() < FETCH_GROUP_CHUNK_SIZE && !mAttributeCache.contains(group->at(position - distance), fieldId)) ids << group->at(position - distance);
+	}
+
+	// nothing to coalesce, the prepared single row query is cheaper
+	if (ids.size() < 2) return false;
+
+	QStringList idList;
+	foreach (int other, ids) idList << QString::number(other);
+
+	QSet<int> found;
+	QSqlQuery query(database());
+	query.setForwardOnly(true);
+
+	if (!query.exec(QString("SELECT match_id, %1 FROM %3 WHERE match_id IN (%2)").arg(field).arg(idList.join(",")).arg(fieldTable(field)))) {
+		qDebug() << "SQLDatabase::fetchGroupValue: query failed:" << query.lastError() << "\n\tQUERY =" << query.lastQuery();
+
+		return false;
+	}
+
+	while (query.next()) {
+		const int matchId = query.value(0).toInt();
+		const QVariant v = query.value(1);
+
+		// a wide attribute the match doesn't have
+		if (v.isNull()) continue;
+
+		mAttributeCache.insert(matchId, fieldId, v);
+		found << matchId;
+
+		if (matchId == id) value = v;
+	}
+
+	// the matches that have no value for this field
+	foreach (int other, ids) {
+		if (!found.contains(other)) mAttributeCache.insert(other, fieldId, QVariant());
+	}
+
+	if (!found.contains(id)) value = QVariant();
+
+	return true;
+}
+
 /**
  * This is definitely much faster for MySQL when VIEW-joins are at play, doesn't hurt SQLite either (other DB systems untested)
  *
@@ -932,6 +2544,7 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 	QString primaryTable = "matches";
 	QString from = primaryTable;
 	QStringList requiredFields = parameters.preloadFields;
+	QSet<QString> innerFields; // the fields the inner query of a late row lookup fetches
 
 	// collect dependencies
 	QSet<QString> dependencies = parameters.filter.dependencies().toSet();
@@ -964,10 +2577,10 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 			from = primaryTable + ((options.testFlag(ForcePrimaryIndex) && supports(FORCE_INDEX_MYSQL)) ? QString(" FORCE INDEX (PRIMARY) ") : QString(" "));
 		}
 		else {
-			primaryTable = parameters.sortField;
-			from = primaryTable + (supports(FORCE_INDEX_MYSQL) ? QString(" FORCE INDEX (%1_index) ").arg(parameters.sortField) : QString(" "));
+			primaryTable = fieldTable(parameters.sortField);
+			from = primaryTable + (supports(FORCE_INDEX_MYSQL) ? QString(" FORCE INDEX (%1) ").arg(sortIndexName(parameters.sortField)) : QString(" "));
 
-			if (parameters.filter.checkForDependency("source_name") || parameters.filter.checkForDependency("target_name") || parameters.filter.checkForDependency("transformation")) {
+			if (primaryTable != "matches" && (parameters.filter.checkForDependency("source_name") || parameters.filter.checkForDependency("target_name") || parameters.filter.checkForDependency("transformation"))) {
 				// if this is the case we'll have to include "matches" as well for sure, unfortunately
 				dependencies << "matches";
 			}
@@ -999,6 +2612,7 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 
 		from = "(\n\t" + synthesizeQuery(innerParameters, options) + "\n) AS q\n";
 		primaryTable = "q";
+		innerFields = innerParameters.preloadFields.toSet();
 
 		// clear the filter on the current parameters set, because we've already filtered in the inner pass
 		parameters.filter.clear();
@@ -1008,27 +2622,43 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 		parameters.offset = -1;
 	}
 
+	// what the inner query fetched is taken from there, a wide attribute would be ambiguous otherwise (matches is joined too)
+	QStringList columns;
+	foreach (const QString& field, requiredFields) {
+		columns << (innerFields.contains(field) ? "q." + field : field);
+	}
+
 	if (options.testFlag(UseLateRowLookup) && parameters.forceLateRowLookupPass) {
-		queryString = QString("SELECT %1.match_id%3 FROM %2").arg(primaryTable).arg(from).arg(requiredFields.isEmpty() ? QString() : QString(", ") + requiredFields.join(", "));
+		queryString = QString("SELECT %1.match_id%3 FROM %2").arg(primaryTable).arg(from).arg(columns.isEmpty() ? QString() : QString(", ") + columns.join(", "));
 	}
 	else {
-		if (requiredFields.isEmpty()) {
-			queryString = QString("SELECT %1.match_id, source_name, target_name, transformation FROM %2").arg(primaryTable).arg(from);
+		if (columns.isEmpty()) {
+			queryString = QString("SELECT %1.match_id, source_name, target_name, %3 FROM %2").arg(primaryTable).arg(from).arg(transformationColumn());
 		}
 		else {
-			queryString = QString("SELECT %2.match_id, source_name, target_name, transformation, %1 FROM %3").arg(requiredFields.join(",")).arg(primaryTable).arg(from);
+			queryString = QString("SELECT %2.match_id, source_name, target_name, %4, %1 FROM %3").arg(columns.join(",")).arg(primaryTable).arg(from).arg(transformationColumn());
 		}
 	}
 
-	//join in dependencies
+	// wide attributes are columns of matches, which only has to be joined if it isn't the primary table
+	QSet<QString> joins = dependencies;
 	foreach (const QString& field, dependencies) {
+		if (mWideMatchFields.contains(field)) {
+			joins.remove(field);
+
+			if (primaryTable != "matches") joins << "matches";
+		}
+	}
+
+	//join in dependencies
+	foreach (const QString& field, joins) {
 		if (mViewMatchFields.contains(field)) {
 			queryString += QString(" LEFT JOIN %1 ON %2.match_id = %1.match_id").arg(field).arg(primaryTable);
 		}
 		else {
 			// if the JOIN table is also the on we're sorting on, it's usually advantageous to let MySQL know
 			// that we'd appreciate it if it used that tables index instead of anything else. This saves a temporary table and a filesort
-			QString force = (field == parameters.sortField && supports(FORCE_INDEX_MYSQL)) ? QString(" FORCE INDEX (%1_index) ").arg(field) : QString(" ");
+			QString force = (field == parameters.sortField && supports(FORCE_INDEX_MYSQL)) ? QString(" FORCE INDEX (%1) ").arg(sortIndexName(field)) : QString(" ");
 
 			// this is so dirty, but MySQL is really forcing my hand here, 10000-fold decrease in query time
 			if (!matchHasField(parameters.sortField)) force = ((options.testFlag(ForcePrimaryIndex) && supports(FORCE_INDEX_MYSQL)) ? QString(" FORCE INDEX (PRIMARY) ") : QString(" "));
@@ -1040,7 +2670,7 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 	// this is where the fast pagination magic happens
 	QString realSortOrder = parameters.order == Qt::AscendingOrder ? "ASC" : "DESC";
 	QString whereConnector = " WHERE ";
-	QString sortPrefix = (dependencies.contains(parameters.sortField)) ? parameters.sortField : primaryTable;
+	QString sortPrefix = (dependencies.contains(parameters.sortField)) ? fieldTable(parameters.sortField) : primaryTable;
 
 	if (parameters.isPaginated) {
 		realSortOrder = "DESC";
@@ -1055,7 +2685,14 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 			if (!parameters.sortField.isEmpty()) {
 				//QString sf = (supports(NEED_TYPECAST_NUMERIC_POSTGRESQL)) ? parameters.sortField + "::numeric" : parameters.sortField;
 				QString cv = (supports(NEED_TYPECAST_NUMERIC_POSTGRESQL)) ? QString::number(parameters.extremeSortValue) + "::real" : QString::number(parameters.extremeSortValue);
-				queryString += QString(" WHERE (%6.%1 %3= %2) AND (%6.match_id %3%5 %4 OR %6.%1 %3 %2)").arg(parameters.sortField).arg(cv).arg(op).arg(parameters.extremeMatchId).arg(parameters.inclusive ? "=" : "").arg(sortPrefix);
+
+				if (supports(ROW_VALUE_COMPARISON)) {
+					// the same predicate, but one the (field, match_id) index can answer with a single range scan
+					queryString += QString(" WHERE ((%5.%1, %5.match_id) %3%4 (%2, %6))").arg(parameters.sortField).arg(cv).arg(op).arg(parameters.inclusive ? "=" : "").arg(sortPrefix).arg(parameters.extremeMatchId);
+				}
+				else {
+					queryString += QString(" WHERE (%6.%1 %3= %2) AND (%6.match_id %3%5 %4 OR %6.%1 %3 %2)").arg(parameters.sortField).arg(cv).arg(op).arg(parameters.extremeMatchId).arg(parameters.inclusive ? "=" : "").arg(sortPrefix);
+				}
 			}
 			else {
 				queryString += QString(" WHERE (%1.match_id %3%4 %2)").arg(sortPrefix).arg(parameters.extremeMatchId).arg(op).arg(parameters.inclusive ? "=" : "");
@@ -1066,7 +2703,17 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 		}
 	}
 
-	if (!parameters.filter.isEmpty()) queryString += whereConnector + "(" + parameters.filter.clauses().join(") AND (") + ")";
+	QStringList clauses = parameters.filter.clauses();
+
+	// the outer query of a late row lookup only gets the matches the inner one selected
+	if (!options.testFlag(UseLateRowLookup) || parameters.forceLateRowLookupPass) {
+		QSet<QString> selecting = parameters.filter.dependencies().toSet();
+		if (matchHasField(parameters.sortField)) selecting << parameters.sortField;
+
+		clauses << notNullClauses(selecting);
+	}
+
+	if (!clauses.isEmpty()) queryString += whereConnector + "(" + clauses.join(") AND (") + ")";
 
 	queryString += " ORDER BY ";
 	if (!parameters.sortField.isEmpty()) queryString += QString("%3.%1 %2, ").arg(parameters.sortField).arg(realSortOrder).arg(sortPrefix);
@@ -1080,7 +2727,18 @@ QString SQLDatabase::synthesizeQuery(SQLQueryParameters& parameters, SQLDatabase
 	return queryString;
 }
 
-QList<thera::SQLFragmentConf> SQLDatabase::fillFragments(const QString& queryString, const QStringList& cacheFields) {
+// fragment names repeat a lot within one result set, so Database::entryIndex() is only asked once per name
+static inline int memoizedEntryIndex(QHash<QString, int>& memo, const QString& name) {
+	QHash<QString, int>::const_iterator i = memo.constFind(name);
+
+	if (i == memo.constEnd()) {
+		i = memo.insert(name, Database::entryIndex(name));
+	}
+
+	return i.value();
+}
+
+QList<thera::SQLFragmentConf> SQLDatabase::fillFragments(const QString& queryString, const QStringList& cacheFields, int expectedRows) {
 	QElapsedTimer timer;
 	timer.start();
 
@@ -1088,117 +2746,368 @@ QList<thera::SQLFragmentConf> SQLDatabase::fillFragments(const QString& queryStr
 
 	QList<SQLFragmentConf> list;
 
-	int fragments[IFragmentConf::MAX_FRAGMENTS];
-	XF xf;
-
 	//qDebug() << "SQLDatabase::fillFragments: going to execute:" << queryString;
 
-	QSqlQuery query(database());
-	query.setForwardOnly(true);
+	QSqlQuery query(database());
+	query.setForwardOnly(true);
+
+	if (query.exec(queryString)) {
+		QSqlRecord rec = query.record();
+
+		// resolve the columns once, fields that aren't part of the result set are simply not preloaded
+		typedef QPair<int, int> IdColumnPair;
+		QVector<IdColumnPair> columns;
+		int cacheSize = 0;
+
+		foreach (const QString& field, cacheFields) {
+			const int column = rec.indexOf(field);
+
+			if (column != -1) {
+				const int id = fieldId(field);
+
+				columns << IdColumnPair(id, column);
+				cacheSize = qMax(cacheSize, id + 1);
+			}
+		}
+
+		const int numColumns = columns.size();
+
+		QHash<QString, int> entryIndices;
+
+		const int rows = (query.size() >= 0) ? query.size() : expectedRows;
+		if (rows > 0) list.reserve(rows);
+
+		queryTime = timer.restart();
+
+		while (query.next()) {
+			// build the conf in place and fill it up, instead of copying one in
+			list.append(SQLFragmentConf(this, query.value(0).toInt()));
+			SQLFragmentConf& conf = list.last();
+
+			conf.mRelev = 1.0f;
+			conf.mFragments[IFragmentConf::SOURCE] = memoizedEntryIndex(entryIndices, query.value(1).toString());
+			conf.mFragments[IFragmentConf::TARGET] = memoizedEntryIndex(entryIndices, query.value(2).toString());
+
+			conf.mXF = XF();
+
+			if (mBinaryTransformations) {
+				// straight from the bytes, no string parsing
+				decodeTransformation(query.value(3).toByteArray(), conf.mXF);
+			}
+			else {
+				QTextStream ts(query.value(3).toString().toAscii());
+				ts >> conf.mXF;
+			}
+
+			conf.mCache.resize(cacheSize);
+
+			for (int i = 0; i < numColumns; ++i) {
+				conf.mCache[columns.at(i).first] = query.value(columns.at(i).second);
+			}
+		}
+	}
+	else {
+		qDebug() << "SQLDatabase::fillFragments: query failed:" << query.lastError()
+				<< "\nQuery executed:" << query.lastQuery();
+	}
+
+	fillTime = timer.elapsed();
+	qDebug() << "SQLDatabase::fillFragments: QUERY =" << queryString << "\n\tquery took" << queryTime << "msec and filling the list took" << fillTime << "msec (filled" << list.size() << "SQLFragmentConf's)";
+
+	return list;
+}
+
+bool SQLDatabase::historyAvailable() const {
+	return mTrackHistory;
+}
+
+QList<HistoryRecord> SQLDatabase::getHistory(const QString& field, const QString& sortField, Qt::SortOrder order, const SQLFilter& filter, int offset, int limit) {
+	sync();
+
+	QList<HistoryRecord> list;
+
+	if (!matchHasField(field)) {
+		qDebug() << "SQLDatabase::getHistory: field" << field << "did not exist";
+
+		return list;
+	}
+
+	QString queryString = QString("SELECT user_id, match_id, timestamp, %1 FROM %1_history").arg(field);
+
+	QSet<QString> historyFields = QSet<QString>() << "match_id" << "user_id" << "timestamp" << field;
+	if (!sortField.isEmpty()) {
+		if (!historyFields.contains(sortField)) {
+			qDebug() << "SQLDatabase::getHistory: attempted to sort on field" << sortField << "which doesn't exist";
+		}
+	}
+
+	// add filter clauses
+	/*
+	if (!filter.isEmpty()) {
+		queryString += " WHERE (" + filter.clauses().join(") AND (") + ")";
+	}
+	*/
+
+	if (!sortField.isEmpty()) {
+		queryString += QString(" ORDER BY %1 %2").arg(sortField).arg(order == Qt::AscendingOrder ? "ASC" : "DESC");
+	}
+
+	QSqlQuery query(database());
+	query.setForwardOnly(true);
+
+	if (query.exec(queryString)) {
+		while (query.next()) {
+			list << HistoryRecord(
+				query.value(0).toInt(),
+				query.value(1).toInt(),
+				QDateTime::fromTime_t(query.value(2).toUInt()),
+				query.value(3)
+			);
+		}
+	}
+	else {
+		qDebug() << "SQLDatabase::getHistory query failed:" << query.lastError()
+			<< "\nQuery executed:" << query.lastQuery();
+	}
+
+	return list;
+}
+
+QList<HistoryRecord> SQLDatabase::getHistory(const QString& field, const QList<int>& matchIds, const QDateTime& from, const QDateTime& to) {
+	sync();
+
+	QList<HistoryRecord> list;
+
+	if (!matchHasField(field)) {
+		qDebug() << "SQLDatabase::getHistory: field" << field << "did not exist";
+
+		return list;
+	}
+
+	QStringList clauses;
+	if (from.isValid()) clauses << QString("timestamp >= %1").arg(from.toTime_t());
+	if (to.isValid()) clauses << QString("timestamp <= %1").arg(to.toTime_t());
+
+	// sorted, so the records of the chunks come out in match order as well
+	QList<int> ids = matchIds.toSet().toList();
+	qSort(ids);
+
+	// an empty IN list stands for every match
+	QStringList chunks;
+	if (ids.isEmpty()) chunks << QString();
+
+	for (int begin = 0; begin < ids.size(); begin += FETCH_GROUP_CHUNK_SIZE) {
+		QStringList chunk;
+
+		for (int k = begin; k < qMin(ids.size(), begin + FETCH_GROUP_CHUNK_SIZE); ++k) {
+			chunk << QString::number(ids.at(k));
+		}
+
+		chunks << chunk.join(",");
+	}
+
+	QSqlQuery query(database());
+	query.setForwardOnly(true);
+
+	foreach (const QString& chunk, chunks) {
+		QStringList where = clauses;
+		if (!chunk.isEmpty()) where << QString("match_id IN (%1)").arg(chunk);
+
+		QString queryString = QString("SELECT user_id, match_id, timestamp, %1 FROM %1_history").arg(field);
+		if (!where.isEmpty()) queryString += " WHERE " + where.join(" AND ");
+		queryString += " ORDER BY match_id, timestamp";
+
+		if (!query.exec(queryString)) {
+			qDebug() << "SQLDatabase::getHistory query failed:" << query.lastError()
+				<< "\nQuery executed:" << query.lastQuery();
+
+			return QList<HistoryRecord>();
+		}
+
+		while (query.next()) {
+			list << HistoryRecord(
+				query.value(0).toInt(),
+				query.value(1).toInt(),
+				QDateTime::fromTime_t(query.value(2).toUInt()),
+				query.value(3)
+			);
+		}
+	}
+
+	return list;
+}
+
+int SQLDatabase::compactHistory(const QString& field, const QDateTime& before) {
+	if (!mTrackHistory || !matchHasRealField(field)) {
+		qDebug() << "SQLDatabase::compactHistory: there's no history for" << field;
+
+		return -1;
+	}
+
+	sync();
+
+	// the latest record of every match before the cutoff is what it was at that time, everything older than it can go
+	// those are collected first, MySQL can't select from the table that's being deleted from and a derived table would be
+	// grouped all over again for every row
+	QSqlQuery query(database());
+
+	if (!transaction()) {
+		qDebug() << "SQLDatabase::compactHistory: couldn't start transaction:" << database().lastError();
+
+		return -1;
+	}
+
+	bool succes = query.exec(dropTemporaryTableQuery("history_latest"))
+		&& query.exec("CREATE TEMPORARY TABLE history_latest (match_id INTEGER PRIMARY KEY, latest INTEGER NOT NULL)");
+
+	if (succes) {
+		query.prepare(QString("INSERT INTO history_latest (match_id, latest) SELECT match_id, MAX(timestamp) FROM %1_history WHERE timestamp < ? GROUP BY match_id").arg(field));
+		query.addBindValue(before.toTime_t());
+
+		succes = query.exec();
+	}
+
+	int removed = -1;
+
+	if (succes) {
+		succes = query.exec(QString(
+			"DELETE FROM %1_history WHERE timestamp < ("
+				"SELECT latest FROM history_latest WHERE history_latest.match_id = %1_history.match_id"
+			")"
+		).arg(field));
+
+		removed = query.numRowsAffected();
+	}
+
+	if (!succes) {
+		qDebug() << "SQLDatabase::compactHistory: couldn't compact the history of" << field << "->" << query.lastError() << "\n\tQUERY =" << query.lastQuery();
 
-	if (query.exec(queryString)) {
-		QSqlRecord rec = query.record();
+		database().rollback();
+		query.exec(dropTemporaryTableQuery("history_latest"));
 
-		typedef QPair<QString, int> StringIntPair;
-		QList<StringIntPair> fieldIndexList;
-		foreach (const QString& field, cacheFields) {
-			//qDebug() << "Adding preload field for caching:" << StringIntPair(field, rec.indexOf(field));
-			fieldIndexList << StringIntPair(field, rec.indexOf(field));
-		}
+		return -1;
+	}
 
-		queryTime = timer.restart();
+	succes = commit();
+	query.exec(dropTemporaryTableQuery("history_latest"));
 
-		while (query.next()) {
-			fragments[IFragmentConf::SOURCE] = Database::entryIndex(query.value(1).toString());
-			fragments[IFragmentConf::TARGET] = Database::entryIndex(query.value(2).toString());
+	if (!succes) return -1;
 
-			QMap<QString, QVariant> cache;
-			foreach (const StringIntPair& pair, fieldIndexList) {
-				//qDebug() << "Caching fastpath: " << pair << "for id" << query.value(0).toInt();
+	qDebug() << "SQLDatabase::compactHistory: removed" << removed << "superseded records of" << field;
 
-				cache.insert(pair.first, query.value(pair.second));
-			}
+	return removed;
+}
 
-			QTextStream ts(query.value(3).toString().toAscii());
-			ts >> xf;
+QFuture<QList<thera::SQLFragmentConf> > SQLDatabase::getMatchesAsync(const SQLQueryParameters& parameters, const QString& supersedeKey) {
+	// the pool threads can't see what's still queued
+	sync();
 
-			list << SQLFragmentConf(this, cache, query.value(0).toInt(), fragments, 1.0f, xf);
-		}
-	}
-	else {
-		qDebug() << "SQLDatabase::fillFragments: query failed:" << query.lastError()
-				<< "\nQuery executed:" << query.lastQuery();
-	}
+	return startAsync(new SQLMatchesQuery(this, parameters), supersedeKey);
+}
 
-	fillTime = timer.elapsed();
-	qDebug() << "SQLDatabase::fillFragments: QUERY =" << queryString << "\n\tquery took" << queryTime << "msec and filling the list took" << fillTime << "msec (filled" << list.size() << "SQLFragmentConf's)";
+QFuture<int> SQLDatabase::getNumberOfMatchesAsync(const SQLFilter& filter, const QString& supersedeKey) {
+	// the pool threads can't see what's still queued
+	sync();
 
-	return list;
+	return startAsync(new SQLCountQuery(this, filter), supersedeKey);
 }
 
-bool SQLDatabase::historyAvailable() const {
-	return mTrackHistory;
+QFuture<QList<HistoryRecord> > SQLDatabase::getHistoryAsync(const QString& field, const QString& sortField, Qt::SortOrder order, const SQLFilter& filter, int offset, int limit, const QString& supersedeKey) {
+	// the pool threads can't see what's still queued
+	sync();
+
+	return startAsync(new SQLHistoryQuery(this, field, sortField, order, filter, offset, limit), supersedeKey);
 }
 
-QList<HistoryRecord> SQLDatabase::getHistory(const QString& field, const QString& sortField, Qt::SortOrder order, const SQLFilter& filter, int offset, int limit) {
-	QList<HistoryRecord> list;
+void SQLDatabase::cancelAsync(const QString& supersedeKey) {
+	QMutexLocker locker(&mAsyncMutex);
 
-	if (!matchHasField(field)) {
-		qDebug() << "SQLDatabase::getHistory: field" << field << "did not exist";
+	mSupersedable.take(supersedeKey).cancel();
+}
 
-		return list;
-	}
+template<typename T> QFuture<T> SQLDatabase::startAsync(SQLAsyncQuery<T> *query, const QString& supersedeKey) {
+	QFuture<T> future = query->future();
 
-	QString queryString = QString("SELECT user_id, match_id, timestamp, %1 FROM %1_history").arg(field);
+	if (!supersedeKey.isEmpty()) {
+		QMutexLocker locker(&mAsyncMutex);
 
-	QSet<QString> historyFields = QSet<QString>() << "match_id" << "user_id" << "timestamp" << field;
-	if (!sortField.isEmpty()) {
-		if (!historyFields.contains(sortField)) {
-			qDebug() << "SQLDatabase::getHistory: attempted to sort on field" << sortField << "which doesn't exist";
+		// forget the ones that are done
+		QMutableHashIterator<QString, QFuture<void> > i(mSupersedable);
+		while (i.hasNext()) {
+			if (i.next().value().isFinished()) i.remove();
 		}
-	}
 
-	// add filter clauses
-	/*
-	if (!filter.isEmpty()) {
-		queryString += " WHERE (" + filter.clauses().join(") AND (") + ")";
+		mSupersedable.value(supersedeKey).cancel();
+		mSupersedable.insert(supersedeKey, future);
 	}
-	*/
 
-	if (!sortField.isEmpty()) {
-		queryString += QString(" ORDER BY %1 %2").arg(sortField).arg(order == Qt::AscendingOrder ? "ASC" : "DESC");
+	if (canCloneConnection() && isOpen()) {
+		mQueryPool.start(query);
+	}
+	else {
+		query->run();
+		delete query;
 	}
 
-	QSqlQuery query(database());
-	query.setForwardOnly(true);
+	return future;
+}
 
-	if (query.exec(queryString)) {
-		while (query.next()) {
-			list << HistoryRecord(
-				query.value(0).toInt(),
-				query.value(1).toInt(),
-				QDateTime::fromTime_t(query.value(2).toUInt()),
-				query.value(3)
-			);
+void SQLDatabase::stopAsync() {
+	{
+		QMutexLocker locker(&mAsyncMutex);
+
+		foreach (QFuture<void> future, mSupersedable) {
+			future.cancel();
 		}
-	}
-	else {
-		qDebug() << "SQLDatabase::getHistory query failed:" << query.lastError()
-			<< "\nQuery executed:" << query.lastQuery();
+
+		mSupersedable.clear();
 	}
 
-	return list;
+	mQueryPool.waitForDone();
 }
 
 QList<AttributeRecord> SQLDatabase::getAttribute(const QString& field) {
+	sync();
+
 	QList<AttributeRecord> list;
 
-	// TODO: obviously...
+	SQLAttributeReader reader = attributeReader(field);
+	AttributeRecord record;
+
+	while (reader.next(record)) {
+		list << record;
+	}
+
+	if (reader.hasError()) {
+		qDebug() << "SQLDatabase::getAttribute: couldn't read all values of" << field << "only got" << list.size();
+	}
 
 	return list;
 }
 
+SQLAttributeReader SQLDatabase::attributeReader(const QString& field, int chunkSize) {
+	// the queued writes have to be visible to the reader
+	sync();
+
+	if (!matchHasField(field)) {
+		qDebug() << "SQLDatabase::attributeReader: field" << field << "did not exist";
+
+		return SQLAttributeReader(database(), QString(), QString(), chunkSize);
+	}
+
+	// meta attributes are read from their view (or the table it was materialized into), which is named after them as well
+	// a view is computed again for every query, so it's read in one go
+	if (mViewMatchFields.contains(field) && !materializedMetaAttributes().contains(field)) chunkSize = 0;
+
+	// a wide attribute that is NULL counts as missing, like a match without a row in the attribute's table
+	const QStringList present = notNullClauses(QSet<QString>() << field);
+
+	return SQLAttributeReader(database(), fieldTable(field), field, chunkSize, present.join(" AND "));
+}
+
 const QDomDocument SQLDatabase::toXML() {
+	sync();
+
 	if (!isOpen()) {
 		qDebug() << "Database wasn't open, couldn't convert to XML";
 
@@ -1226,14 +3135,7 @@ const QDomDocument SQLDatabase::toXML() {
 			match.setAttribute(field, conf.getString(field, QString()));
 		}
 
-		QString xf;
-		for (int col = 0; col < 4; ++col) {
-			for (int row = 0; row < 4; ++row) {
-				xf += QString("%1 ").arg(conf.mXF[4 * row + col], 0, 'e', 20);
-			}
-		}
-
-		match.setAttribute("xf", xf);
+		match.setAttribute("xf", transformationToString(conf.mXF));
 
 		matches.appendChild(match);
 	}
@@ -1264,162 +3166,122 @@ int SQLDatabase::matchCount() const {
 	}
 }
 
-/**
- * TODO: batch queries (make VariantList's)
- * TODO: more sanity-checking for corrupt matches.xml
- * TODO: decide if we use the preset matches.xml id, or a new one
- */
-void SQLDatabase::parseXML(const QDomElement &root) {
-	register int i = 1;
-
-	QSqlDatabase db(database());
-
-	QStringList integerAttributes = QStringList() << "status";
-	QStringList floatAttributes = QStringList() << "error" << "overlap" << "volume" << "old_volume" << "probability";
-	QStringList stringAttributes = QStringList();
+void SQLDatabase::setAttributeCacheCapacity(int entries) {
+	mAttributeCache.setCapacity(entries);
+}
 
-	// create the attribute tables if they don't exist
-	foreach (const QString& attr, integerAttributes) {
-		if (!matchHasRealField(attr)) addMatchField(attr, "INTEGER", "0");
-	}
+int SQLDatabase::attributeCacheCapacity() const {
+	return mAttributeCache.capacity();
+}
 
-	foreach (const QString& attr, floatAttributes) {
-		if (!matchHasRealField(attr)) addMatchField(attr, "REAL", "0");
-	}
+quint64 SQLDatabase::attributeCacheHits() const {
+	return mAttributeCache.hits();
+}
 
-	foreach (const QString& attr, stringAttributes) {
-		if (!matchHasRealField(attr)) addMatchField(attr, "TEXT", "0");
-	}
+quint64 SQLDatabase::attributeCacheMisses() const {
+	return mAttributeCache.misses();
+}
 
-	transaction();
+void SQLDatabase::resetAttributeCacheStatistics() {
+	mAttributeCache.resetStatistics();
+}
 
-	// prepare queries
-	QSqlQuery matchesQuery(db);
-	matchesQuery.prepare(
-		"INSERT INTO matches (match_id, source_name,target_name, transformation) "
-		"VALUES (:match_id, :source_name, :target_name, :transformation)"
-	);
-	/*
-	matchesQuery.prepare(
-		"INSERT INTO matches (match_id, source_id, source_name, target_id, target_name, transformation) "
-		"VALUES (:match_id, :source_id, :source_name, :target_id, :target_name, :transformation)"
-	);
-	*/
+void SQLDatabase::clearAttributeCache() {
+	mAttributeCache.clear();
+}
 
-	QSqlQuery conflictsQuery(db);
-	conflictsQuery.prepare(
-		"INSERT INTO conflicts (match_id, other_match_id) "
-		"VALUES (:match_id, :other_match_id)"
-	);
+// QDomElement::attribute() lookalike for the streaming reader
+static inline QString xmlAttribute(const QXmlStreamAttributes& attributes, const QString& name, const QString& deflt) {
+	return attributes.hasAttribute(name) ? attributes.value(name).toString() : deflt;
+}
 
-	QSqlQuery statusQuery(db);
-	statusQuery.prepare(
-		"INSERT INTO status (match_id, status) "
-		"VALUES (:match_id, :status)"
-	);
+/**
+ * TODO: more sanity-checking for corrupt matches.xml
+ * TODO: decide if we use the preset matches.xml id, or a new one
+ */
+bool SQLDatabase::parseXML(QXmlStreamReader& xml, qint64 size, SQLImportPipeline& pipeline) {
+	register int i = 1;
 
-	QSqlQuery errorQuery(db);
-	errorQuery.prepare(
-		"INSERT INTO error (match_id, error) "
-		"VALUES (:match_id, :error)"
-	);
+	pipeline.begin();
 
-	QSqlQuery overlapQuery(db);
-	overlapQuery.prepare(
-		"INSERT INTO overlap (match_id, overlap) "
-		"VALUES (:match_id, :overlap)"
-	);
+	SQLImportRawChunk chunk;
+	chunk.reserve(SQLImportPipeline::CHUNK_SIZE);
 
-	QSqlQuery volumeQuery(db);
-	volumeQuery.prepare(
-		"INSERT INTO volume (match_id, volume) "
-		"VALUES (:match_id, :volume)"
-	);
+	QElapsedTimer timer;
+	timer.start();
 
-	QSqlQuery old_volumeQuery(db);
-	old_volumeQuery.prepare(
-		"INSERT INTO old_volume (match_id, old_volume) "
-		"VALUES (:match_id, :old_volume)"
-	);
+	// the amount of matches is unknown up front when streaming, so progress is reported in kilobytes read
+	int kbRead = 0;
 
-	QSqlQuery probabilityQuery(db);
-	probabilityQuery.prepare(
-		"INSERT INTO probability (match_id, probability) "
-		"VALUES (:match_id, :probability)"
-	);
+	emit databaseOpStarted(tr("Converting XML file to database"), int(size / 1024) + 1);
 
-	emit databaseOpStarted(tr("Converting XML file to database"), root.childNodes().length());
+	while (!xml.atEnd()) {
+		if (xml.readNext() != QXmlStreamReader::StartElement || xml.name() != QLatin1String("match")) continue;
 
-	for (QDomElement match = root.firstChildElement("match"); !match.isNull(); match = match.nextSiblingElement()) {
 		// TODO: how can we check that this isn't already in the table? for now assume clean table
+		const QXmlStreamAttributes match = xml.attributes();
+
+		// only copy the strings here, converting them happens on the worker threads
+		// (case sensitive: "Probability")
+		SQLImportRawMatch raw;
+		raw.id = match.value("id").toString();
+		raw.source = match.value("src").toString();
+		raw.target = match.value("tgt").toString();
+		if (match.hasAttribute("xf")) raw.xf = match.value("xf").toString();
+		if (match.hasAttribute("status")) raw.status = match.value("status").toString();
+		if (match.hasAttribute("error")) raw.error = match.value("error").toString();
+		if (match.hasAttribute("overlap")) raw.overlap = match.value("overlap").toString();
+		if (match.hasAttribute("volume")) raw.volume = match.value("volume").toString();
+		if (match.hasAttribute("old_volume")) raw.oldVolume = match.value("old_volume").toString();
+		if (match.hasAttribute("Probability")) raw.probability = match.value("Probability").toString();
+
+		chunk << raw;
+
+		if (chunk.size() >= SQLImportPipeline::CHUNK_SIZE) {
+			pipeline.add(chunk);
+
+			chunk.clear();
+			chunk.reserve(SQLImportPipeline::CHUNK_SIZE);
+		}
 
-		int matchId = match.attribute("id").toInt();
-		//int matchId = query.lastInsertId().toInt();
-
-		//QString debug = QString("item %1: source = %2, target = %3 || (id = %4)").arg(i).arg(match.attribute("src")).arg(match.attribute("tgt")).arg(matchId);
-		//qDebug() << debug;
-
-		// update matches table
+		if (int(xml.device()->pos() / 1024) != kbRead) {
+			kbRead = int(xml.device()->pos() / 1024);
 
-		//XF transformation;
-		QString rawTransformation(match.attribute("xf", "1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1").toAscii()); // should be QTextStream if we want the real XF
-		//rawTransformation >> transformation;
+			emit databaseOpStepDone(kbRead);
+		}
 
-		matchesQuery.bindValue(":match_id", matchId);
-		//matchesQuery.bindValue(":source_id", 0); // TODO: not use dummy value
-		matchesQuery.bindValue(":source_name", match.attribute("src"));
-		//matchesQuery.bindValue(":target_id", 0); // TODO: not use dummy value
-		matchesQuery.bindValue(":target_name", match.attribute("tgt"));
-		matchesQuery.bindValue(":transformation", rawTransformation);
-		matchesQuery.exec();
+		++i;
+	}
 
-		// update attribute tables
-		statusQuery.bindValue(":match_id", matchId);
-		statusQuery.bindValue(":status", match.attribute("status", "0").toInt());
-		statusQuery.exec();
+	bool succes = false;
 
-		errorQuery.bindValue(":match_id", matchId);
-		errorQuery.bindValue(":error", match.attribute("error", "NaN").toDouble());
-		errorQuery.exec();
+	if (xml.hasError()) {
+		qDebug() << "SQLDatabase::parseXML: malformed XML after" << (i - 1) << "matches, rolling back:" << xml.errorString();
 
-		overlapQuery.bindValue(":match_id", matchId);
-		overlapQuery.bindValue(":overlap", match.attribute("overlap", "0.0").toDouble());
-		overlapQuery.exec();
+		pipeline.abort();
+	}
+	else {
+		pipeline.add(chunk);
 
-		volumeQuery.bindValue(":match_id", matchId);
-		volumeQuery.bindValue(":volume", match.attribute("volume", "0.0").toDouble());
-		volumeQuery.exec();
+		succes = pipeline.finish();
 
-		old_volumeQuery.bindValue(":match_id", matchId);
-		old_volumeQuery.bindValue(":old_volume", match.attribute("old_volume", "0.0").toDouble());
-		old_volumeQuery.exec();
+		qint64 elapsed = qMax(qint64(1), timer.elapsed());
 
-		/*
-		static int j = 0;
-		if (j++ == 0) {
-			for (int k = 0; k < match.attributes().length(); ++k)
-				qDebug() << match.attributes().item(k).toText().data();
+		if (succes) {
+			qDebug() << "SQLDatabase::parseXML: imported" << (i - 1) << "matches," << pipeline.rowsWritten() << "rows in" << elapsed << "msec ="
+				<< (pipeline.rowsWritten() * 1000 / elapsed) << "rows/sec";
 		}
-		*/
-
-		// case sensitive!
-		if (match.hasAttribute("Probability")) {
-			probabilityQuery.bindValue(":match_id", matchId);
-			probabilityQuery.bindValue(":probability", match.attribute("Probability", "0.0").toDouble());
-			probabilityQuery.exec();
+		else {
+			qDebug() << "SQLDatabase::parseXML: writing the matches to the database failed, nothing was imported";
 		}
-
-		emit databaseOpStepDone(i);
-
-		++i;
 	}
 
-	commit();
-
 	emit databaseOpEnded();
+
+	return succes;
 }
 
-void SQLDatabase::parseXMLStressTest(const QDomElement &root, int factor, bool perturb) {
+bool SQLDatabase::parseXMLStressTest(QXmlStreamReader& xml, qint64 size, int factor, bool perturb) {
 	QSqlDatabase db(database());
 
 	QStringList integerAttributes = QStringList() << "status";
@@ -1439,49 +3301,6 @@ void SQLDatabase::parseXMLStressTest(const QDomElement &root, int factor, bool p
 		if (!matchHasRealField(attr)) addMatchField(attr, "TEXT", "");
 	}
 
-	// prepare queries
-	QSqlQuery matchesQuery(db);
-	if (!matchesQuery.prepare(
-		"INSERT INTO matches (match_id, source_name,target_name, transformation) "
-		"VALUES (:match_id, :source_name, :target_name, :transformation)"
-	)) qDebug() << "SQLDatabase::parseXMLStressTest: could not prepare stmt:" << matchesQuery.lastError();
-
-	QSqlQuery statusQuery(db);
-	if (!statusQuery.prepare(
-		"INSERT INTO status (match_id, status) "
-		"VALUES (:match_id, :status)"
-	)) qDebug() << "SQLDatabase::parseXMLStressTest: could not prepare status stmt:" << statusQuery.lastError();
-
-	QSqlQuery errorQuery(db);
-	errorQuery.prepare(
-		"INSERT INTO error (match_id, error) "
-		"VALUES (:match_id, :error)"
-	);
-
-	QSqlQuery overlapQuery(db);
-	overlapQuery.prepare(
-		"INSERT INTO overlap (match_id, overlap) "
-		"VALUES (:match_id, :overlap)"
-	);
-
-	QSqlQuery volumeQuery(db);
-	volumeQuery.prepare(
-		"INSERT INTO volume (match_id, volume) "
-		"VALUES (:match_id, :volume)"
-	);
-
-	QSqlQuery old_volumeQuery(db);
-	old_volumeQuery.prepare(
-		"INSERT INTO old_volume (match_id, old_volume) "
-		"VALUES (:match_id, :old_volume)"
-	);
-
-	QSqlQuery probabilityQuery(db);
-	probabilityQuery.prepare(
-		"INSERT INTO probability (match_id, probability) "
-		"VALUES (:match_id, :probability)"
-	);
-
 	/*
 	if (!commit() && !db.rollback()) {
 		qDebug() << "Something" << db.lastError();
@@ -1498,9 +3317,16 @@ void SQLDatabase::parseXMLStressTest(const QDomElement &root, int factor, bool p
 
 	qDebug() << "BLEEP:" << db.lastError();
 
-	emit databaseOpStarted(tr("Converting XML file to database"), root.childNodes().length());
+	SQLImportBatch batch(db, supports(MULTI_ROW_INSERT), mImportBatchSize);
+	if (mBinaryTransformations) batch.setTransformationColumn(transformationColumn());
+	batch.setMatchColumns(wideMatchFields());
+
+	QElapsedTimer timer;
+	timer.start();
+
+	emit databaseOpStarted(tr("Converting XML file to database"), int(size / 1024) + 1);
 
-	int i = 0;
+	int kbRead = 0;
 	int idcounter = 1;
 
 	/*
@@ -1511,113 +3337,94 @@ void SQLDatabase::parseXMLStressTest(const QDomElement &root, int factor, bool p
 	commit();
 	*/
 
-	for (QDomElement match = root.firstChildElement("match"); !match.isNull(); match = match.nextSiblingElement()) {
+	while (!xml.atEnd()) {
+		if (xml.readNext() != QXmlStreamReader::StartElement || xml.name() != QLatin1String("match")) continue;
+
+		const QXmlStreamAttributes match = xml.attributes();
+
 		//int matchId = match.attribute("id").toInt();
-		QString rawTransformation(match.attribute("xf", "1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1").toAscii());
+		QString rawTransformation(xmlAttribute(match, "xf", "1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1").toAscii());
+		QVariant transformation(rawTransformation);
 
-		bool hasProb = match.hasAttribute("Probability");
+		if (mBinaryTransformations) {
+			XF xf;
+			QTextStream ts(rawTransformation.toAscii());
+			ts >> xf;
 
-		QString source = match.attribute("src");
-		QString target = match.attribute("tgt");
-		int status =  match.attribute("status", "0").toInt();
-		float error =  match.attribute("error", "0").toFloat();
-		float overlap =  match.attribute("overlap", "0").toFloat();
-		float volume =  match.attribute("volume", "0").toFloat();
-		float old_volume =  match.attribute("old_volume", "0").toFloat();
-		float probability = match.attribute("Probability", "0.0").toFloat();
+			transformation = encodeTransformation(xf);
+		}
 
-		for (int j = 0; j < factor; ++j, ++idcounter) {
-			matchesQuery.bindValue(":match_id", idcounter);
-			matchesQuery.bindValue(":source_name", source);
-			matchesQuery.bindValue(":target_name", target);
-			matchesQuery.bindValue(":transformation", rawTransformation);
-			if (!matchesQuery.exec()) {
-				qDebug() << "SQLDatabase::parseXMLStressTest: could not insert match:" << matchesQuery.lastError();
+		bool hasProb = match.hasAttribute("Probability");
 
-				emit databaseOpEnded();
+		QString source = match.value("src").toString();
+		QString target = match.value("tgt").toString();
+		int status =  xmlAttribute(match, "status", "0").toInt();
+		float error =  xmlAttribute(match, "error", "0").toFloat();
+		float overlap =  xmlAttribute(match, "overlap", "0").toFloat();
+		float volume =  xmlAttribute(match, "volume", "0").toFloat();
+		float old_volume =  xmlAttribute(match, "old_volume", "0").toFloat();
+		float probability = xmlAttribute(match, "Probability", "0.0").toFloat();
 
-				return;
-			}
+		for (int j = 0; j < factor; ++j, ++idcounter) {
+			batch.addMatch(idcounter, source, target, transformation);
 
 			// update attribute tables
-			statusQuery.bindValue(":match_id", idcounter);
-			statusQuery.bindValue(":status", (status + qrand()) % 5);
-			//statusQuery.exec();
-			if (!statusQuery.exec()) {
-				qDebug() << "SQLDatabase::parseXMLStressTest: could not insert status:" << statusQuery.lastError();
+			batch.addAttribute("status", idcounter, (status + qrand()) % 5);
+			batch.addAttribute("error", idcounter, error + ((perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0));
+			batch.addAttribute("overlap", idcounter, overlap + ((perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0));
+			batch.addAttribute("volume", idcounter, volume + ((perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0));
+			batch.addAttribute("old_volume", idcounter, old_volume + ((perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0));
 
-				emit databaseOpEnded();
-
-				return;
+			if (hasProb) {
+				batch.addAttribute("probability", idcounter, probability + ((perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0));
 			}
 
-			errorQuery.bindValue(":match_id", idcounter);
-			errorQuery.bindValue(":error", error + (perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0);
-			//errorQuery.exec();
-			if (!errorQuery.exec()) {
-				qDebug() << "SQLDatabase::parseXMLStressTest: could not insert error:" << errorQuery.lastError();
-
-				emit databaseOpEnded();
-
-				return;
-			}
+			if (batch.isFull() && !batch.flush()) {
+				qDebug() << "SQLDatabase::parseXMLStressTest: could not insert batch ending at match" << idcounter << ", rolling back";
 
-			overlapQuery.bindValue(":match_id", idcounter);
-			overlapQuery.bindValue(":overlap", overlap + (perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0);
-			//overlapQuery.exec();
-			if (!overlapQuery.exec()) {
-				qDebug() << "SQLDatabase::parseXMLStressTest: could not insert overlap:" << overlapQuery.lastError();
+				db.rollback();
 
 				emit databaseOpEnded();
 
-				return;
+				return false;
 			}
+		}
 
-			volumeQuery.bindValue(":match_id", idcounter);
-			volumeQuery.bindValue(":volume", volume + (perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0);
-			//volumeQuery.exec();
-			if (!volumeQuery.exec()) {
-				qDebug() << "SQLDatabase::parseXMLStressTest: could not insert volume:" << volumeQuery.lastError();
-
-				emit databaseOpEnded();
+		if (int(xml.device()->pos() / 1024) != kbRead) {
+			kbRead = int(xml.device()->pos() / 1024);
 
-				return;
-			}
+			emit databaseOpStepDone(kbRead);
+		}
+	}
 
-			old_volumeQuery.bindValue(":match_id", idcounter);
-			old_volumeQuery.bindValue(":old_volume", old_volume + (perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0);
-			//old_volumeQuery.exec();
-			if (!old_volumeQuery.exec()) {
-				qDebug() << "SQLDatabase::parseXMLStressTest: could not old insert volume:" << old_volumeQuery.lastError();
+	if (!batch.flush()) {
+		qDebug() << "SQLDatabase::parseXMLStressTest: could not insert the last batch, rolling back";
 
-				emit databaseOpEnded();
+		db.rollback();
 
-				return;
-			}
+		emit databaseOpEnded();
 
-			if (hasProb) {
-				probabilityQuery.bindValue(":match_id", idcounter);
-				probabilityQuery.bindValue(":probability", probability + (perturb && j != 0) ? (float(rand()) / float(RAND_MAX)) : 0);
-				//probabilityQuery.exec();
-				if (!probabilityQuery.exec()) {
-					qDebug() << "SQLDatabase::parseXMLStressTest: could not insert probability:" << probabilityQuery.lastError();
+		return false;
+	}
 
-					emit databaseOpEnded();
+	if (xml.hasError()) {
+		qDebug() << "SQLDatabase::parseXMLStressTest: malformed XML, rolling back:" << xml.errorString();
 
-					return;
-				}
-			}
-		}
+		database().rollback();
+	}
+	else {
+		commit();
 
-		emit databaseOpStepDone(i);
+		qint64 elapsed = qMax(qint64(1), timer.elapsed());
 
-		++i;
+		qDebug() << "SQLDatabase::parseXMLStressTest: imported" << (idcounter - 1) << "matches," << batch.rowsWritten() << "rows in" << elapsed << "msec ="
+			<< (batch.rowsWritten() * 1000 / elapsed) << "rows/sec";
 	}
 
-	commit();
-
 	emit databaseOpEnded();
 	//emit matchCountChanged();
+
+	return !xml.hasError();
 }
 
 void SQLDatabase::reset() {
@@ -1697,13 +3504,47 @@ void SQLDatabase::createHistory() {
 
 	if (!created.isEmpty()) qDebug() << "SQLDatabase::createHistory: history created for fields" << created;
 	if (!kept.isEmpty()) qDebug() << "SQLDatabase::createHistory: history already existed for fields" << kept;
+
+	// the history tables of older databases get their index here as well, if creating one failed before it's left alone
+	const QStringList indexed = setting(HISTORY_INDEXES_SETTING).split(",", QString::SkipEmptyParts) + setting(FAILED_HISTORY_INDEXES_SETTING).split(",", QString::SkipEmptyParts);
+
+	if (!created.isEmpty()) t = tables();
+
+	foreach (const QString& field, mNormalMatchFields) {
+		if (!indexed.contains(field) && t.contains(field + "_history")) createHistoryIndex(field);
+	}
+}
+
+void SQLDatabase::createSortIndexes() {
+	if (!isOpen() || !supports(COMPOSITE_SORT_INDEX)) return;
+
+	sync();
+	stopAsync();
+
+	const QStringList materialized = materializedMetaAttributes();
+
+	QStringList created;
+
+	foreach (const QString& field, mMatchFields) {
+		// views can't be indexed
+		if (!mNormalMatchFields.contains(field) && !materialized.contains(field)) continue;
+
+		if (!mSortIndexFields.contains(field) && createSortIndex(fieldTable(field), field)) {
+			// the single column index is a prefix of the new one, so it's only overhead now
+			dropIndex(fieldTable(field), QStringList() << field);
+
+			created << field;
+		}
+	}
+
+	if (!created.isEmpty()) qDebug() << "SQLDatabase::createSortIndexes: sort indexes created for fields" << created;
 }
 
 // generic method that should work for most SQL db's (doesn't work for SQLite so reimplemented in that specific sublass)
 void SQLDatabase::createHistory(const QString& table) {
 	QSqlQuery query(database());
 
-	if (query.exec(QString("CREATE TABLE %1_history (user_id INT, timestamp INT) AS (SELECT * FROM %1 WHERE 1=2);").arg(table))) {
+	if (query.exec(QString("CREATE TABLE %1_history (user_id INT, timestamp INT) AS (%2);").arg(table).arg(historyTemplateQuery(table)))) {
 		qDebug() << "SQLDatabase::createHistory: succesfully created history for" << table;
 	}
 	else {
@@ -1713,8 +3554,55 @@ void SQLDatabase::createHistory(const QString& table) {
 
 
 void SQLDatabase::close() {
+	// the import uses clones of the connection, it has to be done with them first
+	if (mImportPipeline) {
+		qDebug() << "SQLDatabase::close: waiting for the XML import to finish";
+
+		mImportWatcher.waitForFinished();
+
+		delete mImportPipeline;
+		mImportPipeline = NULL;
+	}
+
+	// nothing that was written may get lost
+	if (isOpen()) sync();
+
+	// what couldn't be written goes with the connection
+	{
+		QMutexLocker locker(&mWriteMutex);
+
+		if (!mPendingWrites.isEmpty()) {
+			qDebug() << "SQLDatabase::close: dropping" << mPendingWrites.size() << "attribute writes that couldn't be written";
+		}
+
+		mPendingWrites.clear();
+		mPendingHistory.clear();
+		mFlushedWrites.clear();
+		mFlushedHistory = 0;
+	}
+
+	mWriteTimer.stop();
+
 	// resource cleanup in any case, after this function is done we should be 100% sure that the database is closed and the resources are cleaned up
 	resetQueries();
+	mAttributeCache.clear();
+	clearCountCache();
+	++mModificationCount;
+
+	{
+		QMutexLocker locker(&mFetchGroupMutex);
+
+		mFetchGroups.clear();
+		mFetchGroupOf.clear();
+	}
+
+	// the pool threads have to be done with their connections, they close them themselves the next time they lease one or when they exit
+	stopAsync();
+
+	if (mConnectionPool) {
+		mConnectionPool->closeAll();
+		mConnectionPool.clear();
+	}
 
 	if (isOpen()) {
 		qDebug() << "SQLDatabase::close: Closing database with connection name" << database().connectionName();
@@ -1733,6 +3621,16 @@ void SQLDatabase::setConnectionName(const QString& connectionName) {
 	mConnectionName = connectionName;
 }
 
+QString SQLDatabase::threadSuffix() {
+	return QString::number(quintptr(QThread::currentThread()), 16);
+}
+
+QSqlDatabase SQLDatabase::threadDatabase() const {
+	if (!mConnectionPool) return QSqlDatabase();
+
+	return mConnectionPool->connection();
+}
+
 void SQLDatabase::resetQueries() {
 	qDeleteAll(mFieldQueryMap);
 	mFieldQueryMap.clear();
@@ -1743,23 +3641,43 @@ void SQLDatabase::resetQueries() {
 void SQLDatabase::makeFieldsSet() {
 	if (!isOpen()) return;
 
+	// the queries on the pool threads read the field sets without a lock, none of them can be running while they're rebuilt
+	stopAsync();
+
 	// clear just in case
 	mMatchFields.clear();
 	mNormalMatchFields.clear();
+	mWideMatchFields.clear();
 	mViewMatchFields.clear();
 
+	// materialized meta-attributes are tables, but they're still computed, so they're treated like the views (LEFT JOINed and never written to)
+	const QStringList materialized = materializedMetaAttributes();
+
 	foreach (const QString& table, tables()) {
 		// check if the tables name is not the 'matches' table itself
 		if (table != "matches") {
 			// check if the table contains a match_id attribute
 			QSet<QString> fields = tableFields(table);
 			if (fields.contains("match_id") && fields.contains(table)) {
-				mNormalMatchFields << table;
+				if (materialized.contains(table)) mViewMatchFields << table;
+				else mNormalMatchFields << table;
+
 				mMatchFields << table;
 			}
 		}
 	}
 
+	// the wide attributes are columns of matches
+	const QSet<QString> matchColumns = tableFields("matches");
+
+	foreach (const QString& field, wideMatchFields()) {
+		if (matchColumns.contains(field)) {
+			mWideMatchFields << field;
+			mNormalMatchFields << field;
+			mMatchFields << field;
+		}
+	}
+
 	// include the view attributes as well but add them to mViewMatchFields as well so we can differentiate them later
 	// from the normal ones
 	foreach (const QString& table, tables(QSql::Views)) {
@@ -1773,6 +3691,24 @@ void SQLDatabase::makeFieldsSet() {
 		}
 	}
 
+	// fields might have been dropped and recreated with other values
+	mAttributeCache.clear();
+	clearCountCache();
+	++mModificationCount;
+
+	// intern the names so the attribute caches can index them by id
+	mMatchFieldIds.fill(false);
+
+	foreach (const QString& field, mMatchFields) {
+		const int id = fieldId(field);
+
+		if (id >= mMatchFieldIds.size()) mMatchFieldIds.resize(id + 1);
+		mMatchFieldIds.setBit(id);
+	}
+
+	// which of them have a (field, match_id) index, see createSortIndex()
+	mSortIndexFields = setting(SORT_INDEXES_SETTING).split(",", QString::SkipEmptyParts).toSet() & mMatchFields;
+
 	// add the default attributs that are special and always there (their "special" status may dissapear later though)
 	//mMatchFields << "source_id" << "source_name" << "target_id" << "target_name" << "transformation";
 }
@@ -4,19 +4,35 @@
 #include <QObject>
 #include <QtSql>
 #include <QDomDocument>
+#include <QXmlStreamReader>
 #include <QList>
 #include <QSet>
 #include <QMap>
 #include <QSharedPointer>
 #include <QWeakPointer>
+#include <QBitArray>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QThreadPool>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QTimer>
 #include <QStringBuilder>
 
 #include "SQLFragmentConf.h"
 #include "SQLFilter.h"
+#include "SQLAttributeCache.h"
+#include "SQLAttributeReader.h"
+#include "SQLAsyncQuery.h"
+#include "SQLConnectionPool.h"
 
 #include "SQLRawTheraRecords.h"
 
 class SQLDatabase;
+class SQLSyntheticDataset;
+class SQLImportPipeline;
 
 struct SQLQueryParameters {
 	SQLQueryParameters(const QStringList& attributesToPreload = QStringList(), const QString& sortAttribute = QString(), Qt::SortOrder sortOrder = Qt::AscendingOrder, const SQLFilter& _filter = SQLFilter())
@@ -46,6 +62,11 @@ struct SQLQueryParameters {
 	// if goForward is true, the relative window will be taken starting from the current pivot going forward
 	// else, it's taken going backwards
 	void moveToRelativeWindow(const thera::SQLFragmentConf& pivot, bool includePivot, bool goForward, int offsetFromCurrent, int windowSize) {
+		moveToRelativeWindow(pivot.index(), (!sortField.isEmpty()) ? pivot.getDouble(sortField, 0.0) : 0.0, includePivot, goForward, offsetFromCurrent, windowSize);
+	}
+
+	// the same, for when only the match id and sort value of the pivot were kept (the sort value is ignored if there is no sort field)
+	void moveToRelativeWindow(int pivotMatchId, double pivotSortValue, bool includePivot, bool goForward, int offsetFromCurrent, int windowSize) {
 		isPaginated = true;
 
 		offset = offsetFromCurrent;
@@ -53,8 +74,8 @@ struct SQLQueryParameters {
 
 		forward = goForward;
 
-		extremeMatchId = pivot.index();
-		extremeSortValue = (!sortField.isEmpty()) ? pivot.getDouble(sortField, 0.0) : 0.0;
+		extremeMatchId = pivotMatchId;
+		extremeSortValue = (!sortField.isEmpty()) ? pivotSortValue : 0.0;
 
 		inclusive = includePivot;
 	}
@@ -94,11 +115,24 @@ class SQLDatabase : public QObject {
 			NoOptions = 0x0000,
 			UseViewEncapsulation = 0x0001, // Performs view encapsulation when meta-attributes are requested but not present as a seperate dependency
 			UseLateRowLookup = 0x0002,  // An optimization that works especially well with MySQL, can't usually be combined with UseViewEncapsulation, forces the database to only look up rows after collecting id's
-			ForcePrimaryIndex = 0x0004 // Generally only possible for MySQL, will force the primary index if no sorting field is used
+			ForcePrimaryIndex = 0x0004, // Generally only possible for MySQL, will force the primary index if no sorting field is used
+			UseTemporaryViews = 0x0008 // View encapsulation through a temporary VIEW instead of a derived table, costs three DDL statements per query, only kept to benchmark against
 			// ... some more options with value which is a power of two
 		 };
 		 Q_DECLARE_FLAGS(Options, Option)
 
+		// attributes are tables of their own, (match_id, <attribute>), by default. In the wide layout the numeric ones are columns
+		// of the matches table instead, which saves a join per attribute in every query that uses them. Text attributes and
+		// duplicate (num_duplicates is computed from it) stay tables, the history is kept per attribute in both layouts
+		enum AttributeLayout {
+			TableLayout,
+			WideLayout
+		};
+
+	public:
+		static const QString NUM_DUPLICATES_FIELD;
+		static const QString NUM_DUPLICATES_QUERY; // the view behind it
+
 	public:
 		SQLDatabase(QObject *parent, const QString& type, bool trackHistory = true);
 		virtual ~SQLDatabase();
@@ -115,6 +149,17 @@ class SQLDatabase : public QObject {
 
 		virtual QString connectionName() const;
 
+		// whether QSqlDatabase::cloneDatabase() gives a connection to the same data, so other threads can use it
+		// reads (getMatches(), getNumberOfMatches(), ...) from threads other than the one the database lives in go through
+		// a clone per thread, writes and matchGetValue()/matchSetValue() are only allowed on the owning thread
+		virtual bool canCloneConnection() const;
+
+		// where those clones come from, NULL while the database is closed. A thread has to hold a lease (see SQLConnectionLease)
+		// while it uses the database, without one it gets an invalid connection
+		QSharedPointer<SQLConnectionPool> connectionPool() const;
+
+		// returns right away, the file is parsed and written on other threads which report through databaseOpStarted()
+		// and the other op signals, xmlLoaded() is emitted when it's done. Only one file can be loaded at a time
 		virtual void loadFromXML(const QString& XMLFile);
 		virtual void saveToXML(const QString& XMLFile);
 
@@ -124,12 +169,27 @@ class SQLDatabase : public QObject {
 		// this in case you only possess small datasets
 		virtual void stressTestFromXML(const QString& XMLFile, int factor = 10, bool perturb = true);
 
+		// fills an empty database with a made-up dataset (see SQLSyntheticDataset) without needing a matches.xml, the rows are
+		// written with the same batched inserts as an import. Returns false if the database wasn't empty or if writing failed,
+		// in which case no matches were added
+		virtual bool generateMatches(const SQLSyntheticDataset& dataset);
+
+		// the amount of matches that are buffered during an XML import before they're written out in one go
+		virtual void setImportBatchSize(int matches);
+		virtual int importBatchSize() const;
+
 		virtual bool addMatchField(const QString& name, double defaultValue);
 		virtual bool addMatchField(const QString& name, const QString& defaultValue);
 		virtual bool addMatchField(const QString& name, int defaultValue);
 		virtual bool addMetaMatchField(const QString& name, const QString& sql); // a metafield is a field computed from other fields, it is usually implemented through an SQL view
 		virtual bool removeMatchField(const QString& name);
 
+		// sets an attribute for every match that passes filter, or to a value per match, with one UPDATE per distinct value instead
+		// of a matchSetValue() per match. The history gets a record per changed match through INSERT ... SELECT. Like matchSetValue(),
+		// only matches that already have the attribute are changed. Returns false if something failed, nothing was changed then
+		bool updateAttribute(const QString& field, const QVariant& value, const SQLFilter& filter);
+		bool updateAttribute(const QString& field, const QHash<int, QVariant>& values);
+
 		// in the filters QMap, the key is the field dependencies and the value is the SQL clause that will be put into a WHERE, they will be concatenated with AND
 		// one could perfectly also include AND's and OR's inside of the value component
 		// example: Key = "error" -> Value = "error < 0.25 OR error > 0.50"
@@ -139,14 +199,42 @@ class SQLDatabase : public QObject {
 		//QList<thera::SQLFragmentConf> getMatches(const QString& sortField = QString(), Qt::SortOrder order = Qt::AscendingOrder, const SQLFilter& filter = SQLFilter(), int offset = -1, int limit = -1);
 		//QList<thera::SQLFragmentConf> getPreloadedMatches(const QStringList& preloadFields, const QString& sortField = QString(), Qt::SortOrder order = Qt::AscendingOrder, const SQLFilter& filter = SQLFilter(), int offset = -1, int limit = -1);
 		//QList<thera::SQLFragmentConf> getFastPaginatedPreloadedMatches(const QStringList& preloadFields, const QString& sortField, Qt::SortOrder order, const SQLFilter& filter, int limit, int extremeMatchId, double extremeSortValue, bool forward, bool inclusive, int offset);
+		// counts are cached per filter (see SQLFilter::normalizedClauses()) until a write could have changed them, the counts
+		// of filters that only depend on status are kept up to date from a histogram of the status values instead
 		int getNumberOfMatches(const SQLFilter& filter = SQLFilter()) const;
 
+		// doesn't wait for a count query: returns the exact count if it's known (exact is set to true), otherwise
+		// the total amount of matches, which is an upper bound
+		int estimateNumberOfMatches(const SQLFilter& filter, bool *exact = NULL) const;
+
 		bool historyAvailable() const;
 		QList<HistoryRecord> getHistory(const QString& field, const QString& sortField = QString(), Qt::SortOrder order = Qt::AscendingOrder, const SQLFilter& filter = SQLFilter(), int offset = -1, int limit = -1);
 
+		// the history of the matches in matchIds (of every match if it's empty) from "from" up to "to", either one can be left invalid
+		// the records are ordered by match and time, which is the order of the (match_id, timestamp) index of the history tables
+		QList<HistoryRecord> getHistory(const QString& field, const QList<int>& matchIds, const QDateTime& from = QDateTime(), const QDateTime& to = QDateTime());
+
+		// removes the records from before "before" that were superseded before then as well, so the value every match had at that
+		// time stays, returns how many records were removed or -1 if it failed
+		int compactHistory(const QString& field, const QDateTime& before = QDateTime::currentDateTime());
+
+		// the same queries without blocking, they run on a small pool of threads that each use their own clone of the connection
+		// starting a query with the same non-empty supersedeKey as an earlier one cancels the earlier one, which is meant for
+		// requests that replace each other (the count for the current filter, for example), the futures can be cancelled as well
+		// for databases that can't be cloned the query is run right away and the future is already finished
+		QFuture<QList<thera::SQLFragmentConf> > getMatchesAsync(const SQLQueryParameters& parameters, const QString& supersedeKey = QString());
+		QFuture<int> getNumberOfMatchesAsync(const SQLFilter& filter, const QString& supersedeKey = QString());
+		QFuture<QList<HistoryRecord> > getHistoryAsync(const QString& field, const QString& sortField = QString(), Qt::SortOrder order = Qt::AscendingOrder, const SQLFilter& filter = SQLFilter(), int offset = -1, int limit = -1, const QString& supersedeKey = QString());
+		void cancelAsync(const QString& supersedeKey);
+
 		// you can see this as a simplified version of getHistory(), it will return all the current values for the attribute of each match
 		QList<AttributeRecord> getAttribute(const QString& field);
 
+		// the same values one by one in match order, for real and meta attributes, this reads any number of matches in constant memory
+		// except for meta attributes that are still views, those are read in one pass which MySQL buffers entirely
+		// the reader uses the connection of the calling thread, an attribute that doesn't exist gives a reader that isn't valid
+		SQLAttributeReader attributeReader(const QString& field, int chunkSize = SQLAttributeReader::DEFAULT_CHUNK_SIZE);
+
 		// the following method will try to convert any standard function that is not available
 		// in the instantiated DB type into a specialized function, an example:
 		// ANSI string concatenation: 'foo' || 'bar' = 'foobar'
@@ -156,6 +244,12 @@ class SQLDatabase : public QObject {
 		virtual QString escapeCharacter() const; // will return an empty string if you have to define an escape character yourself (with ESCAPE '\' for example
 
 		bool matchHasField(const QString& field) const;
+		bool matchHasField(int fieldId) const;
+
+		// attribute names are interned to small integer ids (shared by all connections) so that caches can be plain arrays
+		// fieldId() interns names it hasn't seen before, case-insensitively, it only returns -1 for an empty name
+		static int fieldId(const QString& field);
+		static QString fieldName(int fieldId);
 		const QSet<QString>& matchFields() const;
 
 		bool matchHasRealField(const QString& field) const;
@@ -163,12 +257,52 @@ class SQLDatabase : public QObject {
 
 		int matchCount() const;
 
+		// goes up whenever attribute values or fields change through this object, so copies of match data can tell they're outdated
+		int modificationCount() const;
+
+		// attribute values that aren't preloaded are read one at a time, and those reads go through a shared cache
+		// the hit and miss counters are there to help pick a capacity
+		void setAttributeCacheCapacity(int entries);
+		int attributeCacheCapacity() const;
+		quint64 attributeCacheHits() const;
+		quint64 attributeCacheMisses() const;
+		void resetAttributeCacheStatistics();
+		void clearAttributeCache();
+
 		virtual bool transaction() const;
 		virtual bool commit() const;
 
-		// depending on the database implementations, this will materialize the views of the meta-attributes,
-		// also, it might make them smart views, which keep themselves up to date, or not
+		// attribute writes (matchSetValue(), so SQLFragmentConf::setMetaData()) are queued and written out together in one
+		// transaction, writeDelay() milliseconds after the first one or at the next sync point: sync(), transaction(), commit(),
+		// close() and every query that reads attributes from the database. Writes to the same attribute of the same match are
+		// coalesced, the history still gets all of them. With a delay of 0 every write goes out right away
+		void setWriteDelay(int msec);
+		int writeDelay() const;
+		int pendingWrites() const;
+
+		// turns the meta-attributes that can be kept up to date incrementally (num_duplicates) into tables that are
+		// maintained by triggers, so sorting and filtering on them doesn't recompute the view for every query
+		// the others stay views, returns false if something went wrong (the attribute stays a view then as well)
 		virtual bool materializeMetaAttributes();
+		QStringList materializedMetaAttributes() const;
+
+		AttributeLayout attributeLayout() const;
+
+		// the layout new attributes get, the existing ones are migrated to it one at a time. Returns false if one of them couldn't
+		// be migrated, the ones before it stay migrated (every attribute is in one layout or the other, never halfway)
+		virtual bool setAttributeLayout(SQLDatabase::AttributeLayout layout);
+
+		// gives the attributes of databases made before there were sort indexes theirs, only on the backends that need them
+		// (see createSortIndex()). That rebuilds an index per attribute, so it's only done when asked for
+		void createSortIndexes();
+
+		// transformations are stored either as text, 16 formatted doubles in matches.transformation (schema version 1), or as
+		// a 128 byte blob of little-endian doubles in matches.transformation_bin (schema version 2), which is a lot faster to read
+		int schemaVersion() const;
+		bool hasBinaryTransformations() const;
+
+		// converts all stored transformations in place and updates the schema version, returns false (and changes nothing) if it failed
+		virtual bool convertTransformations(bool toBinary);
 
 		// if the 'id' parameters is -1, a new id is created
 		//		WARNING: if an id is specified and a configuration with the same id already existed, the results are UNDEFINED
@@ -190,14 +324,27 @@ class SQLDatabase : public QObject {
 		void matchCountChanged();
 		void matchFieldsChanged();
 
+		// queued attribute writes couldn't be written, they stay queued for the next sync point (see setWriteDelay())
+		void writesFailed(int writes) const;
+
+		// a loadFromXML() is done, if it didn't succeed nothing was imported
+		void xmlLoaded(bool succes);
+
 	public slots:
 		void close();
 
+		// writes out the queued attribute writes, see setWriteDelay(). Returns false if that failed, the writes stay queued then
+		// only the thread the database lives in can write, on the others this does nothing
+		bool sync() const;
+
 	protected:
 		// for internal usage for now
 		typedef enum {
 			FORCE_INDEX_MYSQL, // database can force specific index usage with MySQL syntax
-			NEED_TYPECAST_NUMERIC_POSTGRESQL // PostgreSQL's typing systems seems to need a conversion to numeric when dealing with real's and exact comparison
+			NEED_TYPECAST_NUMERIC_POSTGRESQL, // PostgreSQL's typing systems seems to need a conversion to numeric when dealing with real's and exact comparison
+			MULTI_ROW_INSERT, // database understands INSERT ... VALUES (...), (...) and it's worth it to save on round trips
+			ROW_VALUE_COMPARISON, // database understands (a, b) > (c, d) and uses an index on (a, b) for it
+			COMPOSITE_SORT_INDEX // an index on a column doesn't include match_id (SQLite's rowid and InnoDB's primary key do), sorting on both needs an index on both
 		} SpecialCapabilities;
 
 	protected:
@@ -210,13 +357,16 @@ class SQLDatabase : public QObject {
 		//virtual QString synthesizeQuery(const QStringList& requiredFields, const QString& sortField, Qt::SortOrder order, const SQLFilter& filter, int offset, int limit) const;
 		// the next one has a lot of arguments, they're commented in the method
 		//virtual QString synthesizeFastPaginatedQuery(const QStringList& requiredFields, const QString& sortField, Qt::SortOrder order, const SQLFilter& filter, int limit, int extremeMatchId, double extremeSortValue, bool forward, bool inclusive, int offset) const;
-		virtual QList<thera::SQLFragmentConf> fillFragments(const QString& query, const QStringList& cacheFields);
+		// expectedRows is only used to reserve room up front, pass -1 if it's not known
+		virtual QList<thera::SQLFragmentConf> fillFragments(const QString& query, const QStringList& cacheFields, int expectedRows = -1);
 
 		virtual bool open(const QString& connName, const QString& dbname, bool dbnameOnly, const QString& host = QString(), const QString& user = QString(), const QString& pass = QString(), int port = 0);
 		virtual bool reopen();
 
 		virtual bool hasCorrectCapabilities() const;
 
+		virtual QString blobSqlType() const;
+
 		virtual QString schemaName() const;
 		virtual QStringList tables(QSql::TableType type = QSql::Tables) const;
 		virtual QSet<QString> tableFields(const QString& tableName) const = 0;
@@ -229,7 +379,45 @@ class SQLDatabase : public QObject {
 
 		virtual QString createViewQuery(const QString& viewName, const QString& selectStatement) const = 0;
 
-		virtual void createIndex(const QString& table, const QStringList& fields);
+		// a trigger that runs statements (which can use NEW and OLD) after every row that event (INSERT, UPDATE or DELETE) touches
+		// the default works for SQLite and MySQL
+		virtual QStringList createTriggerQueries(const QString& name, const QString& table, const QString& event, const QStringList& statements) const;
+		virtual QStringList dropTriggerQueries(const QString& name, const QString& table) const;
+
+		// temporary tables are created with CREATE TEMPORARY TABLE everywhere, dropping them mustn't end the transaction
+		virtual QString dropTemporaryTableQuery(const QString& table) const;
+
+		virtual bool createIndex(const QString& table, const QStringList& fields);
+		virtual bool dropIndex(const QString& table, const QStringList& fields); // doesn't complain if there was no such index
+		static QString indexName(const QStringList& fields);
+
+		// the index every sortable attribute gets, on (field, match_id) where the database needs match_id in it explicitly, so pages
+		// of a sorted query are a range of the index. Elsewhere the index on the field already is that and it's all that's made
+		bool createSortIndex(const QString& table, const QString& field);
+		QString sortIndexName(const QString& field) const; // or the single column index of an attribute that doesn't have one (yet)
+
+		// the index of a history table, on (match_id, timestamp)
+		bool createHistoryIndex(const QString& field);
+
+		// also drops the indexes createIndex() made on the column, call inside a transaction
+		virtual bool dropColumn(const QString& table, const QString& column);
+
+		// the queued attribute writes, in the current transaction
+		bool flushWrites() const;
+
+		// what the last flushWrites() wrote is taken off the queue once it's committed, otherwise it stays and writesFailed() is emitted
+		void writesCommitted(bool committed) const;
+
+		// what the caches hold about field after it was changed behind their back (bulk updates)
+		void attributeChanged(const QString& field);
+
+		// the meta-attributes whose values can change when field does, num_duplicates only depends on duplicate
+		QStringList dependentViewFields(const QString& field) const;
+		static quint64 writeKey(int matchId, int fieldId);
+
+		// the statement that shows how the database would run query, explain() runs it and returns one line per row
+		virtual QString explainQuery(const QString& query) const;
+		QStringList explain(const QString& query) const;
 
 		QSqlDatabase database() const;
 		void reset();
@@ -238,6 +426,23 @@ class SQLDatabase : public QObject {
 		// only for use in getDb
 		void setConnectionName(const QString& connectionName);
 
+		// a small key/value store in the settings table, for things like the schema version
+		QString setting(const QString& name, const QString& deflt = QString()) const;
+		bool setSetting(const QString& name, const QString& value);
+
+		// the column of the matches table that fillFragments() expects as the fourth column
+		QString transformationColumn() const;
+
+		// the table with the column of an attribute: matches for the wide attributes, the attribute's own table for the others
+		QString fieldTable(const QString& field) const;
+
+		// a match without a row in the table of an attribute drops out of the INNER JOIN on it, these make a NULL
+		// column of a wide attribute do the same, so both layouts select the same matches
+		QStringList notNullClauses(const QSet<QString>& fields) const;
+
+		// an empty SELECT with the columns the history table of an attribute starts out with
+		QString historyTemplateQuery(const QString& field) const;
+
 		// fetches a specific query by key and makes it if it doesn't exist
 		QSqlQuery& getOrElse(const QString& key, const QString& queryString);
 
@@ -248,19 +453,62 @@ class SQLDatabase : public QObject {
 		virtual void resetQueries();
 		virtual void makeFieldsSet();
 
+	private slots:
+		void xmlParsed();
+
 	private:
-		void parseXML(const QDomElement &root);
-		void parseXMLStressTest(const QDomElement &root, int factor, bool perturb);
+		// is run on a worker by loadFromXML(), finishXMLImport() does the rest on the thread of the database
+		bool importXML(const QString& XMLFile, SQLImportPipeline *pipeline);
+		void finishXMLImport(bool succes);
+
+		// both return false if the XML was malformed, in which case nothing is inserted
+		bool parseXML(QXmlStreamReader& xml, qint64 size, SQLImportPipeline& pipeline);
+		bool parseXMLStressTest(QXmlStreamReader& xml, qint64 size, int factor, bool perturb);
 		const QDomDocument toXML();
 
+		// remembers the matches of a getMatches() call as one fetch group, see fetchGroupValue()
+		void registerFetchGroup(const QList<thera::SQLFragmentConf>& list);
+
+		// on a cache miss, fetches field for the matches around id in its fetch group that aren't cached yet (at most
+		// FETCH_GROUP_CHUNK_SIZE), with one WHERE match_id IN (...) query instead of a query per match. Returns false if id
+		// isn't part of a group
+		bool fetchGroupValue(int id, const QString& field, int fieldId, QVariant& value) const;
+
+		void readSettings();
+
+		// see getNumberOfMatches(), all of these lock mCountMutex themselves
+		bool cachedNumberOfMatches(const QString& key, int& count) const;
+		bool matchingStatuses(const SQLFilter& filter, QList<int>& statuses) const;
+		bool maintainsStatusCounts() const;
+		void clearCountCache() const;
+		// call after a value was written, oldValue is only used for status and has to be invalid if the match had no status
+		void updateCountCache(const QString& field, const QVariant& oldValue, const QVariant& newValue);
+
+		// the attributes the settings say are stored wide, mWideMatchFields has the ones that are actually in use
+		QStringList wideMatchFields() const;
+		bool moveToWideLayout(const QString& field, const QString& sqlType);
+		bool moveToTableLayout(const QString& field, const QString& sqlType);
+
+		static bool fitsWideLayout(const QString& field, const QString& sqlType);
+		static QString columnSqlType(QVariant::Type type);
+
+		template<typename T> QFuture<T> startAsync(SQLAsyncQuery<T> *query, const QString& supersedeKey);
+		// cancels everything that is queued and waits for what is running
+		// everything that changes the schema calls it first, the queries read the field sets and tables it changes
+		void stopAsync();
+
+		// the connection of the calling thread, if it's not the thread this database lives in
+		QSqlDatabase threadDatabase() const;
+
+		// something unique to the calling thread that can be appended to connection and view names
+		static QString threadSuffix();
+
 		// doesn't send the matchFieldsChanged() singal, you have to do that yourself if necessary
 		template<typename T> bool addMatchField(const QString& name, const QString& sqlType, T defaultValue, bool indexValue = true);
 
 		template<typename T> void matchSetValue(int id, const QString& field, const T& value);
 		template<typename T> T matchGetValue(int id, const QString& field, const T& deflt) const;
 
-		template<typename T> void matchAddHistoryRecord(int id, const QString& field, const T& value);
-
 	private:
 		// disabling copy-constructor and copy-assignment for now
 		SQLDatabase(const SQLDatabase&);
@@ -272,6 +520,10 @@ class SQLDatabase : public QObject {
 		QString mConnectionName;
 		QString mType;
 
+		// the last query getMatches() ran on the thread the database lives in, so SQLDatabaseBenchmarker can explain it
+		// empty if it went through a temporary view, which doesn't exist anymore afterwards
+		QString mLastMatchesQuery;
+
 		// a map that will store prepared queries, for performance reasons
 		// it's not actually necessary but it speeds things up and will
 		// be created on the fly if empty
@@ -281,11 +533,74 @@ class SQLDatabase : public QObject {
 		// a set that stores all the available fields/attributes for matches
 		typedef QSet<QString> MatchFieldSet;
 		MatchFieldSet mMatchFields;
-		MatchFieldSet mNormalMatchFields; // fields that exist as real database tables
+		MatchFieldSet mNormalMatchFields; // fields that exist as real database tables (or columns of matches, see below)
+		MatchFieldSet mWideMatchFields; // normal fields that are columns of the matches table
 		MatchFieldSet mViewMatchFields; // fiels that exists solely as views
+		MatchFieldSet mSortIndexFields; // fields that have a sort index, see createSortIndex()
+		QBitArray mMatchFieldIds; // mMatchFields by fieldId()
 
 		bool mTrackHistory;
 
+		int mImportBatchSize;
+
+		// the loadFromXML() that's running, the parsing and writing happen off the thread of the database
+		SQLImportPipeline *mImportPipeline;
+		QFutureWatcher<bool> mImportWatcher;
+
+		bool mBinaryTransformations;
+
+		// caches the results of matchGetValue()
+		mutable SQLAttributeCache mAttributeCache;
+
+		// the write-behind queue of matchSetValue(), see setWriteDelay()
+		struct PendingWrite {
+			int matchId;
+			QString field;
+			QVariant value;
+			uint timestamp;
+		};
+
+		// only the owning thread writes to the queue, the others can read it through matchGetValue()
+		mutable QMutex mWriteMutex;
+		mutable QHash<quint64, PendingWrite> mPendingWrites; // the last value per match and field, by writeKey()
+		mutable QList<PendingWrite> mPendingHistory; // every value, in order
+		mutable QHash<quint64, PendingWrite> mFlushedWrites; // what the last flushWrites() wrote, until it's committed
+		mutable int mFlushedHistory;
+		mutable QTimer mWriteTimer;
+		int mWriteDelay;
+
+		int mModificationCount;
+
+		struct CachedCount {
+			int count; // unused if statusOnly
+			QSet<QString> dependencies;
+
+			// the count is the sum of the status histogram over these values
+			bool statusOnly;
+			QList<int> statuses;
+		};
+
+		// everything to do with counting is protected by mCountMutex, counting can happen on other threads
+		mutable QMutex mCountMutex;
+		mutable QHash<QString, CachedCount> mCountCache; // by SQLFilter::normalizedClauses()
+		mutable QHash<int, int> mStatusHistogram; // status -> amount of matches
+		mutable bool mStatusHistogramValid;
+		mutable int mCountGeneration; // goes up with every change, counts that were started before one aren't cached
+
+		// the most recent getMatches() results (i.e. the model windows), so a miss for one match can be resolved for all its neighbours
+		typedef QSharedPointer<const QVector<int> > FetchGroup;
+		mutable QMutex mFetchGroupMutex;
+		QQueue<FetchGroup> mFetchGroups;
+		QHash<int, FetchGroup> mFetchGroupOf;
+
+		// runs the ...Async() queries
+		QThreadPool mQueryPool;
+		QMutex mAsyncMutex;
+		QHash<QString, QFuture<void> > mSupersedable;
+
+		// the per-thread clones of the connection
+		QSharedPointer<SQLConnectionPool> mConnectionPool;
+
 	private:
 		static const QString SCHEMA_FILE;
 
@@ -294,10 +609,32 @@ class SQLDatabase : public QObject {
 		static const QString OLD_MATCHES_VERSION;
 		static const QString MATCHES_VERSION;
 
+		static const int BINARY_TRANSFORMATIONS_SCHEMA_VERSION;
+
+		static const QString STATUS_FIELD;
+
+		static const QString MATERIALIZED_SETTING;
+		static const QString LAYOUT_SETTING;
+		static const QString WIDE_FIELDS_SETTING;
+		static const QString SORT_INDEXES_SETTING;
+		static const QString HISTORY_INDEXES_SETTING;
+		static const QString FAILED_HISTORY_INDEXES_SETTING;
+
+		static const int MAX_FETCH_GROUPS;
+		static const int FETCH_GROUP_CHUNK_SIZE;
+		static const int MAX_FETCH_GROUP_SIZE; // bigger resultsets aren't registered as a fetch group
+
+		static const int DEFAULT_WRITE_DELAY;
+
 		static QHash<QString, QWeakPointer<SQLDatabase> > mActiveConnections;
 
+		static QHash<QString, int> mFieldIds;
+		static QStringList mFieldNames;
+		static QReadWriteLock mFieldIdLock;
+
 	private:
 		friend class thera::SQLFragmentConf;
+		friend class SQLDatabaseBenchmarker;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(SQLDatabase::Options)
@@ -310,14 +647,30 @@ inline bool SQLDatabase::matchHasField(const QString& field) const {
 	return mMatchFields.contains(field.toLower());
 }
 
+inline bool SQLDatabase::matchHasField(int fieldId) const {
+	return fieldId >= 0 && fieldId < mMatchFieldIds.size() && mMatchFieldIds.testBit(fieldId);
+}
+
 inline const QSet<QString>& SQLDatabase::realMatchFields() const {
 	return mNormalMatchFields;
 }
 
+inline int SQLDatabase::modificationCount() const {
+	return mModificationCount;
+}
+
 inline bool SQLDatabase::matchHasRealField(const QString& field) const {
 	return mNormalMatchFields.contains(field.toLower());
 }
 
+inline QString SQLDatabase::fieldTable(const QString& field) const {
+	return mWideMatchFields.contains(field) ? QString("matches") : field;
+}
+
+inline quint64 SQLDatabase::writeKey(int matchId, int fieldId) {
+	return (quint64(quint32(matchId)) << 32) | quint32(fieldId);
+}
+
 inline QSqlQuery& SQLDatabase::getOrElse(const QString& key, const QString& queryString) {
 	FieldQueryMap::const_iterator i = mFieldQueryMap.constFind(key);
 
@@ -333,43 +686,88 @@ inline QSqlQuery& SQLDatabase::getOrElse(const QString& key, const QString& quer
 }
 
 template<typename T> inline void SQLDatabase::matchSetValue(int id, const QString& field, const T& value) {
-	QSqlQuery &query = getOrElse(field % "update", QString("UPDATE %1 SET %1 = :value WHERE match_id = :match_id").arg(field));
+	// the status counts are adjusted instead of recounted and only the num_duplicates of the old and the new master change,
+	// for both the old value is needed
+	const QStringList dependentViews = dependentViewFields(field);
+	const bool countsDuplicates = field == "duplicate" && dependentViews.contains(NUM_DUPLICATES_FIELD);
 
-	query.bindValue(":match_id", id);
-	query.bindValue(":value", QVariant(value).toString());
+	QVariant oldValue;
+	if ((field == STATUS_FIELD && maintainsStatusCounts()) || countsDuplicates) oldValue = matchGetValue<QVariant>(id, field, QVariant());
 
-	if (!query.exec()) {
-		qDebug()
-			<< "SQLDatabase::matchSetValue: Query failed:" << query.lastError()
-			<< "\nQuery executed: " << query.executedQuery();
-			//<< "\nBound values:" <<query.boundValues();
-	}
-	else if (mTrackHistory) {
-		matchAddHistoryRecord(id, field, value);
+	const int fid = fieldId(field);
+
+	PendingWrite write;
+	write.matchId = id;
+	write.field = field;
+	write.value = QVariant(value);
+	write.timestamp = QDateTime::currentDateTime().toTime_t();
+
+	{
+		QMutexLocker locker(&mWriteMutex);
+
+		mPendingWrites.insert(writeKey(id, fid), write);
+		if (mTrackHistory) mPendingHistory << write;
 	}
 
-	query.finish();
-}
+	updateCountCache(field, oldValue, write.value);
 
-template<typename T> inline void SQLDatabase::matchAddHistoryRecord(int id, const QString& field, const T& value) {
-	QSqlQuery &query = getOrElse(field % "history", QString("INSERT INTO %1_history (timestamp, user_id, match_id, %1) VALUES (:timestamp, :user_id, :match_id, :value)").arg(field));
+	++mModificationCount;
 
-	query.bindValue(":timestamp", QDateTime::currentDateTime().toTime_t());
-	query.bindValue(":user_id", 0);
-	query.bindValue(":match_id", id);
-	query.bindValue(":value", QVariant(value).toString());
-	//query.bindValue(":confidence", 1.0);
+	// the queue answers for it until it's written, after that it's read back
+	mAttributeCache.invalidate(id, fid);
+
+	foreach (const QString& viewField, dependentViews) {
+		if (countsDuplicates && viewField == NUM_DUPLICATES_FIELD) {
+			const int nfid = fieldId(viewField);
 
-	if (!query.exec())
-		qDebug() << "SQLDatabase::matchAddHistoryRecord: could not insert history record:" << query.lastError();
+			if (oldValue.isValid()) mAttributeCache.invalidate(oldValue.toInt(), nfid);
+			mAttributeCache.invalidate(write.value.toInt(), nfid);
+		}
+		else {
+			// no telling which matches those depend on
+			mAttributeCache.invalidateField(fieldId(viewField));
+		}
+	}
+
+	if (mWriteDelay <= 0) sync();
+	else if (!mWriteTimer.isActive()) mWriteTimer.start(mWriteDelay);
 }
 
 template<typename T> inline T SQLDatabase::matchGetValue(int id, const QString& field, const T& deflt) const {
+	const int fid = fieldId(field);
+	QVariant cached;
+
+	bool viewNeedsSync = false;
+
+	{
+		QMutexLocker locker(&mWriteMutex);
+
+		if (!mPendingWrites.isEmpty()) {
+			QHash<quint64, PendingWrite>::const_iterator i = mPendingWrites.constFind(writeKey(id, fid));
+
+			if (i != mPendingWrites.constEnd()) return i.value().value.value<T>();
+
+			// the database computes the meta-attributes from the others, which it has to have first
+			viewNeedsSync = mViewMatchFields.contains(field);
+		}
+	}
+
+	if (viewNeedsSync) sync();
+
+	if (mAttributeCache.lookup(id, fid, cached)) {
+		return cached.isValid() ? cached.value<T>() : deflt;
+	}
+
+	// the other matches of the window will most likely want this field too
+	if (fetchGroupValue(id, field, fid, cached)) {
+		return cached.isValid() ? cached.value<T>() : deflt;
+	}
+
 	if (!mFieldQueryMap.contains(field)) {
 		// doesn't exist yet, make and insert
 		QSqlQuery *q = new QSqlQuery(database());
 
-		q->prepare(QString("SELECT %1 FROM %1 WHERE match_id = :match_id").arg(field));
+		q->prepare(QString("SELECT %1 FROM %2 WHERE match_id = :match_id").arg(field).arg(fieldTable(field)));
 
 		mFieldQueryMap.insert(field, q);
 	}
@@ -379,11 +777,19 @@ template<typename T> inline T SQLDatabase::matchGetValue(int id, const QString&
 	query.bindValue(":match_id", id);
 
 	if (query.exec()) {
-		if (query.next()) {
-			return query.value(0).value<T>();
+		// wide attributes are NULL for the matches that don't have them, which is the same as not having a row
+		if (query.next() && !query.value(0).isNull()) {
+			const QVariant value = query.value(0);
+
+			mAttributeCache.insert(id, fid, value);
+
+			return value.value<T>();
 		}
 		else {
 			//qDebug() << "SQLDatabase::matchGetValue: no record was returned";
+
+			// remember that there's nothing, so sparse attributes don't cost a query every time
+			mAttributeCache.insert(id, fid, QVariant());
 		}
 	}
 	else {
@@ -399,6 +805,9 @@ template<typename T> inline T SQLDatabase::matchGetValue(int id, const QString&
 }
 
 inline QSqlDatabase SQLDatabase::database() const {
+	// connections can only be used in the thread that created them
+	if (QThread::currentThread() != thread()) return threadDatabase();
+
 	return QSqlDatabase::database(mConnectionName, false);
 }
 
@@ -1,6 +1,9 @@
 #include "SQLDatabaseBenchmarker.h"
 
 #include <QDebug>
+#include <QHash>
+#include <QRegExp>
+#include <QSettings>
 
 SQLDatabaseBenchmarker::SQLDatabaseBenchmarker(SQLDatabase *db) {
 	setDatabase(db);
@@ -36,6 +39,105 @@ void SQLDatabaseBenchmarker::setRepetitionConfigurations(const QList< QList< QPa
 	}
 }
 
+bool SQLDatabaseBenchmarker::loadScenario(const QString& filename) {
+	if (!mDb) return false;
+
+	if (!QFile::exists(filename)) {
+		qDebug() << "SQLDatabaseBenchmarker::loadScenario: scenario" << filename << "doesn't exist";
+
+		return false;
+	}
+
+	QSettings scenario(filename, QSettings::IniFormat);
+
+	if (scenario.status() != QSettings::NoError) {
+		qDebug() << "SQLDatabaseBenchmarker::loadScenario: couldn't parse scenario" << filename;
+
+		return false;
+	}
+
+	if (scenario.contains("general/options")) {
+		SQLDatabase::Options options = SQLDatabase::NoOptions;
+
+		foreach (const QString& option, scenario.value("general/options").toString().split(' ', QString::SkipEmptyParts)) {
+			if (option == "UseViewEncapsulation") options |= SQLDatabase::UseViewEncapsulation;
+			else if (option == "UseLateRowLookup") options |= SQLDatabase::UseLateRowLookup;
+			else if (option == "ForcePrimaryIndex") options |= SQLDatabase::ForcePrimaryIndex;
+			else if (option == "UseTemporaryViews") options |= SQLDatabase::UseTemporaryViews;
+			else qDebug() << "SQLDatabaseBenchmarker::loadScenario: unknown option" << option;
+		}
+
+		mDb->setOptions(options);
+	}
+
+	QList<QStringList> preloadConfigurations;
+
+	int size = scenario.beginReadArray("preload");
+	for (int i = 0; i < size; ++i) {
+		scenario.setArrayIndex(i);
+
+		preloadConfigurations << scenarioList(scenario.value("fields"));
+	}
+	scenario.endArray();
+
+	QList<ModelParameters> parameterConfigurations;
+
+	size = scenario.beginReadArray("parameters");
+	for (int i = 0; i < size; ++i) {
+		scenario.setArrayIndex(i);
+
+		SQLFilter filter(mDb);
+
+		// filter, filter2, ... each become a clause of their own
+		foreach (const QString& key, scenario.childKeys()) {
+			if (key.startsWith("filter")) {
+				const QString clause = scenarioList(scenario.value(key)).join(",");
+
+				if (!clause.isEmpty()) filter.setFilter("scenario_" + key, clause);
+			}
+		}
+
+		const Qt::SortOrder order = (scenario.value("order").toString() == "descending") ? Qt::DescendingOrder : Qt::AscendingOrder;
+
+		parameterConfigurations << ModelParameters(filter, QString(), scenario.value("sort").toString(), order);
+	}
+	scenario.endArray();
+
+	QList<WindowList> repetitionConfigurations;
+
+	size = scenario.beginReadArray("walks");
+	for (int i = 0; i < size; ++i) {
+		scenario.setArrayIndex(i);
+
+		// begin+size pairs separated by spaces
+		WindowList windows;
+
+		foreach (const QString& window, scenario.value("windows").toString().split(' ', QString::SkipEmptyParts)) {
+			const QStringList pair = window.split('+');
+
+			if (pair.size() != 2) {
+				qDebug() << "SQLDatabaseBenchmarker::loadScenario: window" << window << "isn't of the form begin+size, skipping it";
+
+				continue;
+			}
+
+			windows << WindowPair(pair.at(0).toInt(), pair.at(1).toInt());
+		}
+
+		if (!windows.isEmpty()) repetitionConfigurations << windows;
+	}
+	scenario.endArray();
+
+	// the defaults fill in whatever the scenario left out
+	setPreloadConfigurations(preloadConfigurations);
+	setParameterConfigurations(parameterConfigurations);
+	setRepetitionConfigurations(repetitionConfigurations);
+
+	qDebug() << "SQLDatabaseBenchmarker::loadScenario: loaded" << mPreloadConfigurations.size() << "preloads," << mParameterConfigurations.size() << "parameters and" << mRepetitionConfigurations.size() << "walks from" << filename;
+
+	return true;
+}
+
 void SQLDatabaseBenchmarker::start(const QString& filename) {
 	if (!mDb) return;
 
@@ -93,6 +195,365 @@ void SQLDatabaseBenchmarker::start(const QString& filename) {
 	*/
 }
 
+void SQLDatabaseBenchmarker::startFillBenchmark(const QString& filename, int rows, int repetitions) {
+	if (!mDb) return;
+
+	QFile file(filename);
+	file.open(QIODevice::WriteOnly | QIODevice::Text);
+	QTextStream stream(&file);
+
+	const QStringList preload = mDb->realMatchFields().toList();
+
+	SQLQueryParameters parameters(preload);
+	parameters.moveToAbsoluteWindow(0, rows);
+
+	const QString query = mDb->synthesizeQuery(parameters, mDb->options());
+
+	stream << "Fill benchmark, " << rows << " rows, preloading: " << preload.join(", ") << "\n";
+	stream << "usec/row\n";
+
+	// warm up the database caches so the first pass isn't penalized
+	mDb->fillFragments(query, preload, rows);
+
+	QElapsedTimer timer;
+	double total = 0.0;
+	int valid = 0;
+
+	for (int i = 0; i < repetitions; ++i) {
+		timer.start();
+		int filled = mDb->fillFragments(query, preload, rows).size();
+		qint64 time = timer.nsecsElapsed();
+
+		if (filled == 0) {
+			qDebug() << "SQLDatabaseBenchmarker::startFillBenchmark: the fill is empty";
+
+			stream << "invalid\n";
+
+			continue;
+		}
+
+		double perRow = time / 1000.0 / filled;
+
+		total += perRow;
+		++valid;
+
+		stream << perRow << "\n";
+	}
+
+	if (valid > 0) {
+		stream << "average: " << (total / valid) << "\n";
+
+		qDebug() << "SQLDatabaseBenchmarker::startFillBenchmark:" << (total / valid) << "usec/row";
+	}
+}
+
+void SQLDatabaseBenchmarker::startViewBenchmark(const QString& filename) {
+	if (!mDb) return;
+
+	QFile file(filename);
+	file.open(QIODevice::WriteOnly | QIODevice::Text);
+	QTextStream stream(&file);
+
+	const SQLDatabase::Options options = mDb->options();
+
+	QElapsedTimer timer;
+	qint64 viewTotal = 0, derivedTotal = 0;
+	int mismatches = 0;
+
+	stream << "View encapsulation benchmark\n";
+	stream << "temporary view msec, derived table msec\n";
+
+	foreach (const WindowList& windows, mRepetitionConfigurations) {
+		foreach (const QStringList& preload, mPreloadConfigurations) {
+			foreach (const ModelParameters& par, mParameterConfigurations) {
+				stream << "[PRELOADING: " << preload.join(", ") << "] with parameters [" << par.toString() << "]\n";
+
+				foreach (const WindowPair& window, windows) {
+					SQLQueryParameters parameters(preload, par.sortField, par.sortOrder, par.filter);
+					parameters.moveToAbsoluteWindow(window.first, window.second);
+
+					// late row lookup would disable view encapsulation altogether
+					mDb->setOptions(SQLDatabase::UseViewEncapsulation | SQLDatabase::UseTemporaryViews);
+					timer.start();
+					const QList<thera::SQLFragmentConf> viewMatches = mDb->getMatches(parameters);
+					const qint64 viewTime = timer.elapsed();
+
+					mDb->setOptions(SQLDatabase::UseViewEncapsulation);
+					timer.start();
+					const QList<thera::SQLFragmentConf> derivedMatches = mDb->getMatches(parameters);
+					const qint64 derivedTime = timer.elapsed();
+
+					if (!sameMatches(viewMatches, derivedMatches, preload)) {
+						qDebug() << "SQLDatabaseBenchmarker::startViewBenchmark: results differ for window" << window.first << window.second << "with parameters" << par.toString();
+
+						++mismatches;
+						stream << "mismatch, mismatch\n";
+
+						continue;
+					}
+
+					viewTotal += viewTime;
+					derivedTotal += derivedTime;
+
+					stream << viewTime << ", " << derivedTime << "\n";
+					stream.flush();
+				}
+			}
+		}
+	}
+
+	mDb->setOptions(options);
+
+	stream << "total: " << viewTotal << ", " << derivedTotal << " (" << mismatches << " mismatches)\n";
+
+	qDebug() << "SQLDatabaseBenchmarker::startViewBenchmark: temporary views took" << viewTotal << "msec, derived tables" << derivedTotal << "msec," << mismatches << "mismatches";
+}
+
+bool SQLDatabaseBenchmarker::startPlanBenchmark(const QString& filename) {
+	if (!mDb) return false;
+
+	mRecords.clear();
+
+	QElapsedTimer timer;
+	int configuration = 0;
+
+	foreach (const WindowList& windows, mRepetitionConfigurations) {
+		foreach (const QStringList& preload, mPreloadConfigurations) {
+			mPreloadFields = preload;
+
+			foreach (const ModelParameters& parameters, mParameterConfigurations) {
+				mPar = parameters;
+				++configuration;
+
+				for (int paginate = 1; paginate >= 0; --paginate) {
+					mMatches.clear();
+
+					for (int i = 0; i < windows.size(); ++i) {
+						const WindowPair& window = windows.at(i);
+
+						QueryRecord record;
+						record.configuration = QString("[%1] [PRELOADING: %2] with parameters [%3]").arg(configuration).arg(mPreloadFields.join(", ")).arg(mPar.toString());
+						record.paginated = paginate;
+						record.key = QString("%1 window %2 [%3,%4] %5")
+							.arg(record.configuration)
+							.arg(i)
+							.arg(window.first)
+							.arg(window.second)
+							.arg(paginate ? "paginated" : "absolute");
+
+						timer.start();
+						doPass(window.first, window.second, paginate);
+						record.msec = timer.nsecsElapsed() / 1000000.0;
+						record.rows = mMatches.size();
+
+						// explaining isn't part of the timing, the query it explains is the one getMatches() just ran
+						record.plan = mDb->explain(mDb->mLastMatchesQuery);
+
+						mRecords << record;
+					}
+				}
+			}
+		}
+	}
+
+	qDebug() << "SQLDatabaseBenchmarker::startPlanBenchmark: recorded" << mRecords.size() << "queries";
+
+	return filename.endsWith(".json", Qt::CaseInsensitive) ? writeJson(filename) : writeCsv(filename);
+}
+
+int SQLDatabaseBenchmarker::compareWithBaseline(const QString& baselineFilename, const QString& filename, double tolerance, double minMsec) {
+	QFile baselineFile(baselineFilename);
+
+	if (!baselineFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		qDebug() << "SQLDatabaseBenchmarker::compareWithBaseline: couldn't open baseline" << baselineFilename;
+
+		return -1;
+	}
+
+	// key -> (msec, plan)
+	QHash<QString, QPair<double, QString> > baseline;
+
+	QTextStream in(&baselineFile);
+	in.readLine(); // header
+
+	while (!in.atEnd()) {
+		const QStringList fields = csvFields(in.readLine());
+
+		if (fields.size() < 4) continue;
+
+		baseline.insert(fields.at(0), qMakePair(fields.at(1).toDouble(), fields.at(3)));
+	}
+
+	QFile file(filename);
+	file.open(QIODevice::WriteOnly | QIODevice::Text);
+	QTextStream stream(&file);
+
+	int regressions = 0, missing = 0;
+
+	stream << "Regressions against " << baselineFilename << " (tolerance " << tolerance * 100.0 << "%, at least " << minMsec << " msec)\n";
+
+	foreach (const QueryRecord& record, mRecords) {
+		if (!baseline.contains(record.key)) {
+			++missing;
+
+			continue;
+		}
+
+		const QPair<double, QString>& base = baseline.value(record.key);
+		const QString plan = record.plan.join(" ; ");
+
+		if (normalizedPlan(plan) != normalizedPlan(base.second)) {
+			++regressions;
+
+			stream << "plan changed: " << record.key << "\n\tbaseline: " << base.second << "\n\tnow:      " << plan << "\n";
+		}
+
+		if (record.msec > base.first * (1.0 + tolerance) && record.msec - base.first >= minMsec) {
+			++regressions;
+
+			stream << "slower: " << record.key << "\n\t" << base.first << " msec -> " << record.msec << " msec\n";
+		}
+	}
+
+	stream << regressions << " regressions, " << missing << " queries not in the baseline\n";
+
+	qDebug() << "SQLDatabaseBenchmarker::compareWithBaseline:" << regressions << "regressions," << missing << "queries not in the baseline";
+
+	return regressions;
+}
+
+bool SQLDatabaseBenchmarker::writeCsv(const QString& filename) const {
+	QFile file(filename);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		qDebug() << "SQLDatabaseBenchmarker::writeCsv: couldn't open" << filename;
+
+		return false;
+	}
+
+	QTextStream stream(&file);
+
+	stream << "query,msec,rows,plan\n";
+
+	foreach (const QueryRecord& record, mRecords) {
+		stream << csvField(record.key) << "," << record.msec << "," << record.rows << "," << csvField(record.plan.join(" ; ")) << "\n";
+	}
+
+	return true;
+}
+
+bool SQLDatabaseBenchmarker::writeJson(const QString& filename) const {
+	QFile file(filename);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		qDebug() << "SQLDatabaseBenchmarker::writeJson: couldn't open" << filename;
+
+		return false;
+	}
+
+	QTextStream stream(&file);
+
+	stream << "{\n\t\"database\": " << jsonString(mDb->mType) << ",\n\t\"options\": " << int(mDb->options()) << ",\n\t\"queries\": [";
+
+	for (int i = 0; i < mRecords.size(); ++i) {
+		const QueryRecord& record = mRecords.at(i);
+
+		QStringList plan;
+		foreach (const QString& line, record.plan) {
+			plan << jsonString(line);
+		}
+
+		stream << ((i == 0) ? "\n" : ",\n")
+			<< "\t\t{ \"query\": " << jsonString(record.key)
+			<< ", \"msec\": " << record.msec
+			<< ", \"rows\": " << record.rows
+			<< ", \"plan\": [" << plan.join(", ") << "] }";
+	}
+
+	stream << "\n\t]\n}\n";
+
+	return true;
+}
+
+QString SQLDatabaseBenchmarker::normalizedPlan(const QString& plan) {
+	return QString(plan).replace(QRegExp("\\d+(\\.\\d+)?"), "#").simplified();
+}
+
+QString SQLDatabaseBenchmarker::csvField(const QString& value) {
+	QString field = value;
+	field.replace('\n', ' ');
+
+	return "\"" + field.replace("\"", "\"\"") + "\"";
+}
+
+QStringList SQLDatabaseBenchmarker::csvFields(const QString& line) {
+	QStringList fields;
+	QString field;
+	bool quoted = false;
+
+	for (int i = 0; i < line.size(); ++i) {
+		const QChar c = line.at(i);
+
+		if (quoted) {
+			if (c == '"' && i + 1 < line.size() && line.at(i + 1) == '"') {
+				field += c;
+				++i;
+			}
+			else if (c == '"') quoted = false;
+			else field += c;
+		}
+		else if (c == '"') quoted = true;
+		else if (c == ',') {
+			fields << field;
+			field.clear();
+		}
+		else field += c;
+	}
+
+	fields << field;
+
+	return fields;
+}
+
+QString SQLDatabaseBenchmarker::jsonString(const QString& value) {
+	QString escaped;
+
+	foreach (const QChar& c, value) {
+		if (c == '"') escaped += "\\\"";
+		else if (c == '\\') escaped += "\\\\";
+		else if (c == '\n') escaped += "\\n";
+		else if (c == '\t') escaped += "\\t";
+		else if (c.unicode() < 0x20) escaped += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+		else escaped += c;
+	}
+
+	return "\"" + escaped + "\"";
+}
+
+QStringList SQLDatabaseBenchmarker::scenarioList(const QVariant& value) {
+	QStringList list;
+
+	foreach (const QString& item, value.toStringList()) {
+		if (!item.trimmed().isEmpty()) list << item.trimmed();
+	}
+
+	return list;
+}
+
+bool SQLDatabaseBenchmarker::sameMatches(const QList<thera::SQLFragmentConf>& a, const QList<thera::SQLFragmentConf>& b, const QStringList& fields) {
+	if (a.size() != b.size()) return false;
+
+	for (int i = 0; i < a.size(); ++i) {
+		if (a.at(i).index() != b.at(i).index()) return false;
+
+		foreach (const QString& field, fields) {
+			if (a.at(i).getString(field) != b.at(i).getString(field)) return false;
+		}
+	}
+
+	return true;
+}
+
 template<typename T>
 void SQLDatabaseBenchmarker::run(T& stream) {
 	QElapsedTimer timer;
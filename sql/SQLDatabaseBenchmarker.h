@@ -10,6 +10,16 @@
 #include "ModelParameters.h"
 
 class SQLDatabaseBenchmarker {
+	public:
+		struct QueryRecord {
+			QString key; // the configuration, window and pass, which identify the query between runs
+			QString configuration; // the preload fields and parameters
+			bool paginated;
+			double msec;
+			int rows;
+			QStringList plan;
+		};
+
 	public:
 		SQLDatabaseBenchmarker(SQLDatabase *db);
 		virtual ~SQLDatabaseBenchmarker();
@@ -19,13 +29,49 @@ class SQLDatabaseBenchmarker {
 		virtual void setPreloadConfigurations(const QList<QStringList>& preloadConfigurations);
 		virtual void setParameterConfigurations(const QList<ModelParameters>& parameterConfigurations);
 		virtual void setRepetitionConfigurations(const QList< QList< QPair<int, int> > >& repetitionConfigurations);
+
+		// reads the preload, parameter and repetition configurations from an INI file, see benchmark/default.scenario for the format
+		// the options in its [general] section are set on the database. Returns false if the file couldn't be read
+		virtual bool loadScenario(const QString& file);
 		virtual void start(const QString& file); // will perform a benchmark of common queries and write them out to file
 
+		// times the per-row cost of SQLDatabase::fillFragments() on a query preloading every real attribute, writes out
+		// one line per repetition (usec/row) and the average, compare the files of two builds to see what a change did
+		virtual void startFillBenchmark(const QString& file, int rows = 10000, int repetitions = 5);
+
+		// runs the windows of every configuration with view encapsulation through a temporary VIEW and through a derived table,
+		// checks that both return the same matches and writes out one line per window (view msec, derived msec) and the totals
+		virtual void startViewBenchmark(const QString& file);
+
+		// runs the windows of every configuration like start() does, paginated and not, and records for every query how long it
+		// took, how many rows it returned and its plan (EXPLAIN, EXPLAIN QUERY PLAN on SQLite). The records are written to file,
+		// as JSON if the name ends in .json and as CSV otherwise. Returns false if the file couldn't be written
+		virtual bool startPlanBenchmark(const QString& file);
+
+		// compares the records of the last startPlanBenchmark() with a CSV file it wrote before, a query regressed if its plan
+		// changed or if it got slower by more than tolerance (a fraction) and by at least minMsec. The regressions are written
+		// to file, returns how many there were or -1 if the baseline couldn't be read
+		virtual int compareWithBaseline(const QString& baselineFile, const QString& file, double tolerance = 0.5, double minMsec = 2.0);
+
+		const QList<QueryRecord>& records() const;
+
 	protected:
 		//virtual void run(QTextStream& stream);
 		template<typename T> void run(T& stream);
 		virtual bool doPass(int requestedWindowBegin, int requestedWindowSize, bool paginate);
 
+		static bool sameMatches(const QList<thera::SQLFragmentConf>& a, const QList<thera::SQLFragmentConf>& b, const QStringList& fields);
+
+		bool writeCsv(const QString& file) const;
+		bool writeJson(const QString& file) const;
+
+		static QString normalizedPlan(const QString& plan); // without the numbers (ids, cost and row estimates), which move with the data
+		static QString csvField(const QString& value);
+		static QStringList csvFields(const QString& line);
+		static QString jsonString(const QString& value);
+
+		static QStringList scenarioList(const QVariant& value); // QSettings splits values on commas, unless they were quoted
+
 	protected:
 		typedef QPair<int, int> WindowPair;
 		typedef QList<WindowPair> WindowList;
@@ -41,6 +87,12 @@ class SQLDatabaseBenchmarker {
 
 		QStringList mPreloadFields;
 		ModelParameters mPar;
+
+		QList<QueryRecord> mRecords; // of the last startPlanBenchmark()
 };
 
+inline const QList<SQLDatabaseBenchmarker::QueryRecord>& SQLDatabaseBenchmarker::records() const {
+	return mRecords;
+}
+
 #endif /* SQLDATABASEBENCHMARKER_H_ */
@@ -108,6 +108,18 @@ QString SQLFilter::toString() const {
 	return s.join(", ");
 }
 
+QString SQLFilter::normalizedClauses() const {
+	QStringList clauses;
+
+	foreach (const QString& clause, mFilters) {
+		clauses << clause.simplified();
+	}
+
+	clauses.sort();
+
+	return clauses.join(") AND (");
+}
+
 /**
  * This may look a bit brute-force-ish, but this is not really performance critical and
  * it works out to be much less error prone and simpler than partial updates
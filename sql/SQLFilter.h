@@ -42,6 +42,10 @@ class SQLFilter {
 
 		virtual QString toString() const;
 
+		// the clauses with their whitespace simplified, sorted and joined, filters that select the same
+		// matches the same way give the same string, regardless of the keys they were set with
+		virtual QString normalizedClauses() const;
+
 	protected slots:
 		virtual void updateDependencyInfo();
 
@@ -3,11 +3,20 @@
 #include "SQLDatabase.h"
 
 namespace thera {
+	// the ids are interned by the database layer, the interface only hands them out
+	int IFragmentConf::fieldId(const QString &field) {
+		return SQLDatabase::fieldId(field);
+	}
+
 	SQLFragmentConf::SQLFragmentConf(SQLDatabase *db, int id) : mDb(db), mId(id) { }
 	SQLFragmentConf::SQLFragmentConf(SQLDatabase *db, int id, int *fragments, float relevance, const XF& xf, const vec3& CP, float CPRadius)
 		: IFragmentConf(fragments, relevance, xf, CP, CPRadius), mDb(db), mId(id) {}
 	SQLFragmentConf::SQLFragmentConf(SQLDatabase *db, const QMap<QString, QVariant>& cache, int id, int *fragments, float relevance, const XF& xf, const vec3& CP, float CPRadius)
-		: IFragmentConf(fragments, relevance, xf, CP, CPRadius), mDb(db), mCache(cache), mId(id) {}
+		: IFragmentConf(fragments, relevance, xf, CP, CPRadius), mDb(db), mId(id) {
+		for (QMap<QString, QVariant>::const_iterator i = cache.constBegin(); i != cache.constEnd(); ++i) {
+			store(SQLDatabase::fieldId(i.key()), i.value());
+		}
+	}
 	SQLFragmentConf::~SQLFragmentConf() { }
 	SQLFragmentConf::SQLFragmentConf(const SQLFragmentConf& that) : IFragmentConf(that), mDb(that.mDb), mCache(that.mCache), mId(that.mId) { }
 	SQLFragmentConf& SQLFragmentConf::operator=(const SQLFragmentConf& that) {
@@ -43,38 +52,66 @@ namespace thera {
 	}
 
 	QString SQLFragmentConf::getString(const QString& field, const QString& deflt) const {
-		return get<QString>(field, deflt);
+		return get<QString>(SQLDatabase::fieldId(field), deflt);
 	}
 
     double SQLFragmentConf::getDouble(const QString& field, double deflt) const {
-    	return get<double>(field, deflt);
+    	return get<double>(SQLDatabase::fieldId(field), deflt);
     }
 
     int SQLFragmentConf::getInt(const QString &field, int deflt) const {
-    	return get<int>(field, deflt);
+    	return get<int>(SQLDatabase::fieldId(field), deflt);
     }
 
-    template<typename T> inline T SQLFragmentConf::get(const QString &field, T deflt) const {
+	QString SQLFragmentConf::getString(int fieldId, const QString& deflt) const {
+		return get<QString>(fieldId, deflt);
+	}
+
+    double SQLFragmentConf::getDouble(int fieldId, double deflt) const {
+    	return get<double>(fieldId, deflt);
+    }
+
+    int SQLFragmentConf::getInt(int fieldId, int deflt) const {
+    	return get<int>(fieldId, deflt);
+    }
+
+    template<typename T> inline T SQLFragmentConf::get(int fieldId, T deflt) const {
     	assert(mId != -1 && mDb != NULL);
 
-    	if (!mDb->matchHasField(field)) {
-    		qDebug() << "SQLFragmentConf::get: match doesn't have field" << field;
+    	// hot path: a cached value is just an array access
+    	const QVariant *value = cached(fieldId);
+
+    	if (value != NULL) {
+    		return value->value<T>();
+    	}
+
+    	if (!mDb->matchHasField(fieldId)) {
+    		qDebug() << "SQLFragmentConf::get: match doesn't have field" << SQLDatabase::fieldName(fieldId);
 
     		return deflt;
     	}
 
-    	CacheMap::const_iterator i = mCache.constFind(field);
+    	store(fieldId, mDb->matchGetValue<T>(mId, SQLDatabase::fieldName(fieldId), deflt));
 
-    	if (i == mCache.constEnd()) {
-			i = mCache.insert(field, mDb->matchGetValue<T>(mId, field, deflt));
+		//qDebug() << "SQLFragmentConf::get: uncached hit for" << SQLDatabase::fieldName(fieldId) << "|" << mId;
 
-			//qDebug() << "SQLFragmentConf::get: uncached hit for" << field << "|" << mId << "|" << i.value().toString();
-    	}
-    	else {
-    		//qDebug() << "SQLFragmentConf::get: cached hit for" << field << "|" << mId << "|" << i.value().toString();
-    	}
+    	return cached(fieldId)->value<T>();
+    }
 
-    	return i.value().value<T>();
+    inline const QVariant *SQLFragmentConf::cached(int fieldId) const {
+    	if (fieldId < 0 || fieldId >= mCache.size()) return NULL;
+
+    	const QVariant& value = mCache.at(fieldId);
+
+    	return value.isValid() ? &value : NULL;
+    }
+
+    inline void SQLFragmentConf::store(int fieldId, const QVariant& value) const {
+    	if (fieldId < 0) return;
+
+    	if (fieldId >= mCache.size()) mCache.resize(fieldId + 1);
+
+    	mCache[fieldId] = value;
     }
 
     template<typename T> inline bool SQLFragmentConf::set(const QString &field, T value) const {
@@ -87,7 +124,7 @@ namespace thera {
 		}
 		else {
 			// cache is write-through because there are too many things we can't control
-			mCache.insert(field, value);
+			store(SQLDatabase::fieldId(field), QVariant(value));
 
 			mDb->matchSetValue(mId, field, value);
 		}
@@ -109,19 +146,19 @@ namespace thera {
     	bool changed = false;
 
     	// compare caches and absorb values
-    	CacheMap::iterator thisPair = mCache.end();
+    	for (int fieldId = 0; fieldId < other.mCache.size(); ++fieldId) {
+    		const QVariant& otherValue = other.mCache.at(fieldId);
 
-    	for (CacheMap::const_iterator otherPair = other.mCache.constBegin(); otherPair != other.mCache.constEnd(); ++otherPair) {
-    		thisPair = mCache.find(otherPair.key());
+    		if (!otherValue.isValid()) continue;
 
-    		if (thisPair != mCache.end()) {
-    			// both keys exist, compare values
-    			//qDebug() << "SQLFragmentConf::absorb: Comparing" << mId << ":" << thisPair.key() << "->" << thisPair.value() << "and" << otherPair.key() << "->" << otherPair.value();
+    		const QVariant *thisValue = cached(fieldId);
 
-    			if (thisPair.value() != otherPair.value()) {
-    				//qDebug() << "SQLFragmentConf::absorb: CHANGE DETECTED!!!!!!!!!!!!!!!!!!!\n\n\n\n\n\nCHAAAAAAAAAAAAAANGE" << ":" << thisPair.key() << "->" << thisPair.value() << "and" << otherPair.key() << "->" << otherPair.value();
+    		if (thisValue != NULL) {
+    			// both keys exist, compare values
+    			//qDebug() << "SQLFragmentConf::absorb: Comparing" << mId << ":" << SQLDatabase::fieldName(fieldId) << "->" << *thisValue << "and" << otherValue;
 
-    				thisPair.value() = otherPair.value();
+    			if (*thisValue != otherValue) {
+    				store(fieldId, otherValue);
 
     				changed = true;
     			}
@@ -130,9 +167,9 @@ namespace thera {
     			// key not found, insert
     			// note that this DOESN'T imply changed == true, because we don't know what the value would have been
     			// it was just not in the cache
-    			//qDebug() << "SQLFragmentConf::absorb: NEW STUFF!" << mId << ":" << "and" << otherPair.key() << "->" << otherPair.value();
+    			//qDebug() << "SQLFragmentConf::absorb: NEW STUFF!" << mId << ":" << "and" << SQLDatabase::fieldName(fieldId) << "->" << otherValue;
 
-    			mCache.insert(otherPair.key(), otherPair.value());
+    			store(fieldId, otherValue);
     		}
     	}
 
@@ -148,7 +185,9 @@ namespace thera {
     		mCache.clear();
     	}
     	else {
-    		mCache.remove(field);
+    		const int fieldId = SQLDatabase::fieldId(field);
+
+    		if (fieldId < mCache.size()) mCache[fieldId] = QVariant();
     	}
     }
 }
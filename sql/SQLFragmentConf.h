@@ -6,6 +6,7 @@
 #include <assert.h>
 
 #include <QMap>
+#include <QVector>
 #include <QVariant>
 
 class SQLDatabase;
@@ -37,6 +38,11 @@ namespace thera {
 			virtual double getDouble(const QString &field, double deflt = 0.0) const;
 			virtual int getInt(const QString &field, int deflt = 0) const;
 
+			// the fast versions, fieldId comes from SQLDatabase::fieldId() and is best looked up once
+			virtual QString getString(int fieldId, const QString &deflt = "") const;
+			virtual double getDouble(int fieldId, double deflt = 0.0) const;
+			virtual int getInt(int fieldId, int deflt = 0) const;
+
 			bool isValid() const;
 
 			// the following 2 are const because they aren't supposed to alter the behaviour of the conf
@@ -54,17 +60,25 @@ namespace thera {
 			virtual void clearCache(const QString& field = QString()) const;
 
 		private:
-			template<typename T> T get(const QString &field, T deflt) const;
+			template<typename T> T get(int fieldId, T deflt) const;
 			template<typename T> bool set(const QString &field, T value) const;
 
+			// NULL if the field isn't cached
+			const QVariant *cached(int fieldId) const;
+			void store(int fieldId, const QVariant& value) const;
+
 		private:
 			SQLDatabase *mDb;
 
 			// the cache is supposed to be transparant, so we can declare it mutable for some const-correctness
-			typedef QMap<QString, QVariant> CacheMap;
-			mutable CacheMap mCache;
+			// it's indexed by SQLDatabase::fieldId(), an invalid QVariant means the field isn't cached
+			typedef QVector<QVariant> CacheVector;
+			mutable CacheVector mCache;
 
 			int mId;
+
+		private:
+			friend class ::SQLDatabase;
 	};
 }
 
@@ -0,0 +1,161 @@
+#include "SQLImportBatch.h"
+
+#include <QStringBuilder>
+
+const int SQLImportBatch::DEFAULT_BATCH_SIZE = 1000;
+const int SQLImportBatch::MAX_BIND_VALUES = 65535;
+
+SQLImportBatch::SQLImportBatch(const QSqlDatabase& db, bool multiRowInsert, int batchSize)
+	: mDb(db), mMultiRowInsert(multiRowInsert), mTransformationColumn("transformation"), mBatchSize(qMax(1, batchSize)), mPendingMatches(0), mRowsWritten(0) {
+}
+
+SQLImportBatch::~SQLImportBatch() {
+	if (mPendingMatches > 0 || !mAttributes.isEmpty()) {
+		qDebug() << "SQLImportBatch::~SQLImportBatch: destroyed with" << mPendingMatches << "matches that were never flushed";
+	}
+}
+
+void SQLImportBatch::addMatch(int matchId, const QString& sourceName, const QString& targetName, const QVariant& transformation) {
+	mMatchIds << matchId;
+	mSourceNames << sourceName;
+	mTargetNames << targetName;
+	mTransformations << transformation;
+
+	++mPendingMatches;
+}
+
+void SQLImportBatch::addAttribute(const QString& field, int matchId, const QVariant& value) {
+	if (mMatchColumns.contains(field)) {
+		mMatchColumnValues[field].insert(matchId, value);
+
+		return;
+	}
+
+	AttributeColumns& columns = mAttributes[field];
+
+	columns.matchIds << matchId;
+	columns.values << value;
+}
+
+bool SQLImportBatch::isFull() const {
+	return mPendingMatches >= mBatchSize;
+}
+
+int SQLImportBatch::rowsWritten() const {
+	return mRowsWritten;
+}
+
+void SQLImportBatch::setTransformationColumn(const QString& column) {
+	mTransformationColumn = column;
+}
+
+void SQLImportBatch::setMatchColumns(const QStringList& fields) {
+	mMatchColumns = fields;
+}
+
+bool SQLImportBatch::flush() {
+	bool success = true;
+
+	if (!mMatchIds.isEmpty()) {
+		QStringList columns = QStringList() << "match_id" << "source_name" << "target_name" << mTransformationColumn;
+		QList<QVariantList> values = QList<QVariantList>() << mMatchIds << mSourceNames << mTargetNames << mTransformations;
+
+		foreach (const QString& field, mMatchColumns) {
+			const QHash<int, QVariant> byMatch = mMatchColumnValues.value(field);
+			QVariantList column;
+			column.reserve(mMatchIds.size());
+
+			foreach (const QVariant& id, mMatchIds) {
+				column << byMatch.value(id.toInt());
+			}
+
+			columns << field;
+			values << column;
+		}
+
+		success &= insert("matches", columns, values);
+	}
+
+	for (QMap<QString, AttributeColumns>::const_iterator it = mAttributes.constBegin(), end = mAttributes.constEnd(); it != end; ++it) {
+		success &= insert(it.key(),
+			QStringList() << "match_id" << it.key(),
+			QList<QVariantList>() << it.value().matchIds << it.value().values
+		);
+	}
+
+	mMatchIds.clear();
+	mSourceNames.clear();
+	mTargetNames.clear();
+	mTransformations.clear();
+	mAttributes.clear();
+	mMatchColumnValues.clear();
+
+	mPendingMatches = 0;
+
+	return success;
+}
+
+bool SQLImportBatch::insert(const QString& table, const QStringList& columns, const QList<QVariantList>& values) {
+	const int rows = values.first().size();
+	const QString placeholders = "(" % QString("?,").repeated(columns.size() - 1) % "?)";
+
+	QSqlQuery query(mDb);
+
+	if (mMultiRowInsert) {
+		// INSERT INTO t (a, b) VALUES (?,?),(?,?),... with the values bound row by row
+		// split up so a statement never has more than MAX_BIND_VALUES placeholders, wide matches tables have many columns
+		const int rowsPerStatement = qMax(1, MAX_BIND_VALUES / columns.size());
+		int prepared = 0; // the amount of rows the prepared statement has placeholders for
+
+		for (int begin = 0; begin < rows; begin += rowsPerStatement) {
+			const int count = qMin(rowsPerStatement, rows - begin);
+
+			if (count != prepared) {
+				QStringList tuples;
+				tuples.reserve(count);
+				for (int row = 0; row < count; ++row) tuples << placeholders;
+
+				if (!query.prepare(QString("INSERT INTO %1 (%2) VALUES %3").arg(table).arg(columns.join(", ")).arg(tuples.join(",")))) {
+					qDebug() << "SQLImportBatch::insert: could not prepare multi-row insert for" << table << ":" << query.lastError();
+
+					return false;
+				}
+
+				prepared = count;
+			}
+
+			for (int row = begin; row < begin + count; ++row) {
+				foreach (const QVariantList& column, values) {
+					query.addBindValue(column.at(row));
+				}
+			}
+
+			if (!query.exec()) {
+				qDebug() << "SQLImportBatch::insert: could not insert" << count << "rows into" << table << ":" << query.lastError();
+
+				return false;
+			}
+		}
+	}
+	else {
+		if (!query.prepare(QString("INSERT INTO %1 (%2) VALUES %3").arg(table).arg(columns.join(", ")).arg(placeholders))) {
+			qDebug() << "SQLImportBatch::insert: could not prepare batch insert for" << table << ":" << query.lastError();
+
+			return false;
+		}
+
+		foreach (const QVariantList& column, values) {
+			query.addBindValue(column);
+		}
+
+		if (!query.execBatch()) {
+			qDebug() << "SQLImportBatch::insert: could not insert" << rows << "rows into" << table << ":" << query.lastError();
+
+			return false;
+		}
+	}
+
+	mRowsWritten += rows;
+
+	return true;
+}
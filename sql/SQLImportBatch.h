@@ -0,0 +1,86 @@
+#ifndef SQLIMPORTBATCH_H_
+#define SQLIMPORTBATCH_H_
+
+#include <QtSql>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QMap>
+#include <QHash>
+
+/**
+ * Collects the rows of an import (the matches table and the attribute tables) and writes
+ * them out per table in batches, instead of one exec() per row per table.
+ *
+ * If multiRowInsert is true, a batch is sent as one multi-row INSERT ... VALUES (...),(...),
+ * which saves a round trip per row on the client/server databases (MySQL, PostgreSQL). Otherwise
+ * QSqlQuery::execBatch() is used, which is just as fast for in-process databases like SQLite
+ * because the prepared statement gets reused.
+ *
+ * Attributes that are columns of the matches table (the wide layout of SQLDatabase) go into the
+ * rows of matches, a match that didn't get a value for one of them gets NULL.
+ *
+ * The batch doesn't manage transactions, that's up to the caller.
+ */
+class SQLImportBatch {
+	public:
+		SQLImportBatch(const QSqlDatabase& db, bool multiRowInsert, int batchSize = DEFAULT_BATCH_SIZE);
+		virtual ~SQLImportBatch();
+
+	public:
+		// the transformation is either the text or the binary form, depending on the column it goes into
+		void addMatch(int matchId, const QString& sourceName, const QString& targetName, const QVariant& transformation);
+		void addAttribute(const QString& field, int matchId, const QVariant& value);
+
+		// true when enough matches have been added to warrant a flush()
+		bool isFull() const;
+
+		// writes out everything that is pending, returns false if any of the inserts failed
+		bool flush();
+
+		int rowsWritten() const;
+
+		// "transformation" by default, "transformation_bin" for databases that store transformations in binary
+		void setTransformationColumn(const QString& column);
+
+		// the attributes that are columns of matches instead of tables, call before adding anything
+		void setMatchColumns(const QStringList& fields);
+
+	public:
+		static const int DEFAULT_BATCH_SIZE;
+
+		// the most placeholders a prepared statement can have on PostgreSQL and MySQL, multi-row inserts are split to stay below it
+		static const int MAX_BIND_VALUES;
+
+	private:
+		bool insert(const QString& table, const QStringList& columns, const QList<QVariantList>& values);
+
+	private:
+		QSqlDatabase mDb;
+
+		bool mMultiRowInsert;
+		QString mTransformationColumn;
+		int mBatchSize;
+
+		int mPendingMatches;
+		int mRowsWritten;
+
+		QVariantList mMatchIds;
+		QVariantList mSourceNames;
+		QVariantList mTargetNames;
+		QVariantList mTransformations;
+
+		struct AttributeColumns {
+			QVariantList matchIds;
+			QVariantList values;
+		};
+
+		// keyed by the attribute (table) name
+		QMap<QString, AttributeColumns> mAttributes;
+
+		// the values of the attributes in mMatchColumns, by match id
+		QStringList mMatchColumns;
+		QMap<QString, QHash<int, QVariant> > mMatchColumnValues;
+};
+
+#endif /* SQLIMPORTBATCH_H_ */
@@ -0,0 +1,321 @@
+#include "SQLImportPipeline.h"
+
+#include <QtConcurrentRun>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+#include "SQLTransformationCodec.h"
+
+#include <limits>
+#include <cstring>
+
+const int SQLImportPipeline::CHUNK_SIZE = 512;
+const int SQLImportPipeline::MAX_QUEUED_CHUNKS = 4;
+
+static const double IDENTITY_XF[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+static const QString IDENTITY_XF_STRING = "1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1";
+
+// fills xf with the 16 whitespace separated values in raw, returns false if there weren't exactly 16 valid numbers
+// the text form is transposed with respect to the memory order of thera::XF, this undoes that
+static bool parseTransformation(const QString& raw, double *xf) {
+	const QList<QByteArray> values = raw.toAscii().simplified().split(' ');
+
+	if (values.size() != 16) return false;
+
+	bool ok = true;
+
+	for (int i = 0; i < 16 && ok; ++i) {
+		xf[4 * (i % 4) + i / 4] = values.at(i).toDouble(&ok);
+	}
+
+	return ok;
+}
+
+static inline double toDouble(const QString& value, double deflt) {
+	bool ok;
+	double d = value.toDouble(&ok);
+
+	return ok ? d : deflt;
+}
+
+SQLImportPipeline::SQLImportPipeline(const QSqlDatabase& db, bool multiRowInsert, int batchSize, bool threadedWriter)
+	: mDb(db),
+	  mConnectionName(QString("%1_import_%2").arg(db.connectionName()).arg(quintptr(this))),
+	  mMultiRowInsert(multiRowInsert),
+	  mBatchSize(batchSize),
+	  mThreadedWriter(threadedWriter),
+	  mBinaryTransformations(false),
+	  mMaxConverting(qMax(2, QThreadPool::globalInstance()->maxThreadCount() * 2)),
+	  mInlineBatch(NULL),
+	  mFinished(false),
+	  mAborted(false),
+	  mFailed(false),
+	  mRowsWritten(0) {
+}
+
+SQLImportPipeline::~SQLImportPipeline() {
+	if (isRunning()) {
+		qDebug() << "SQLImportPipeline::~SQLImportPipeline: still running, aborting";
+
+		abort();
+	}
+
+	delete mInlineBatch;
+}
+
+void SQLImportPipeline::setBinaryTransformations(bool binary) {
+	mBinaryTransformations = binary;
+}
+
+void SQLImportPipeline::setMatchColumns(const QStringList& fields) {
+	mMatchColumns = fields;
+}
+
+bool SQLImportPipeline::begin() {
+	if (mThreadedWriter) {
+		start();
+	}
+	else {
+		if (!mDb.transaction()) {
+			qDebug() << "SQLImportPipeline::begin: could not start transaction:" << mDb.lastError();
+		}
+
+		mInlineBatch = new SQLImportBatch(mDb, mMultiRowInsert, mBatchSize);
+		if (mBinaryTransformations) mInlineBatch->setTransformationColumn("transformation_bin");
+		mInlineBatch->setMatchColumns(mMatchColumns);
+	}
+
+	return true;
+}
+
+void SQLImportPipeline::add(const SQLImportRawChunk& raw) {
+	if (raw.isEmpty()) return;
+
+	// the oldest chunk is always handed off first, so the write order is the order of add()
+	while (mConverting.size() >= mMaxConverting) {
+		handOff(mConverting.dequeue().result());
+	}
+
+	mConverting.enqueue(QtConcurrent::run(&SQLImportPipeline::convert, raw));
+}
+
+bool SQLImportPipeline::finish() {
+	while (!mConverting.isEmpty()) {
+		handOff(mConverting.dequeue().result());
+	}
+
+	if (mThreadedWriter) {
+		{
+			QMutexLocker locker(&mMutex);
+
+			mFinished = true;
+			mNotEmpty.wakeAll();
+		}
+
+		wait();
+	}
+	else if (mInlineBatch) {
+		if (mFailed || !mInlineBatch->flush()) {
+			fail();
+
+			mDb.rollback();
+		}
+		else {
+			mDb.commit();
+		}
+
+		mRowsWritten = mInlineBatch->rowsWritten();
+	}
+
+	QMutexLocker locker(&mMutex);
+
+	return !mFailed && !mAborted;
+}
+
+void SQLImportPipeline::abort() {
+	// drop the conversions that are still running, their results are of no use anymore
+	while (!mConverting.isEmpty()) {
+		mConverting.dequeue().waitForFinished();
+	}
+
+	if (mThreadedWriter) {
+		{
+			QMutexLocker locker(&mMutex);
+
+			mAborted = true;
+			mNotEmpty.wakeAll();
+			mNotFull.wakeAll();
+		}
+
+		wait();
+	}
+	else if (mInlineBatch) {
+		mAborted = true;
+
+		mDb.rollback();
+	}
+}
+
+int SQLImportPipeline::rowsWritten() const {
+	QMutexLocker locker(&mMutex);
+
+	return mRowsWritten;
+}
+
+SQLImportChunk SQLImportPipeline::convert(const SQLImportRawChunk& raw) {
+	SQLImportChunk chunk(raw.size());
+
+	for (int i = 0; i < raw.size(); ++i) {
+		const SQLImportRawMatch& match = raw.at(i);
+		SQLImportRow& row = chunk[i];
+
+		row.matchId = match.id.toInt();
+		row.source = match.source;
+		row.target = match.target;
+
+		if (!match.xf.isNull() && parseTransformation(match.xf, row.xf)) {
+			row.transformation = match.xf;
+		}
+		else {
+			if (!match.xf.isNull()) qDebug() << "SQLImportPipeline::convert: malformed transformation for match" << row.matchId << ", using the identity";
+
+			row.transformation = IDENTITY_XF_STRING;
+			memcpy(row.xf, IDENTITY_XF, sizeof(row.xf));
+		}
+
+		row.status = match.status.isNull() ? 0 : match.status.toInt();
+		row.error = toDouble(match.error, std::numeric_limits<double>::quiet_NaN());
+		row.overlap = toDouble(match.overlap, 0.0);
+		row.volume = toDouble(match.volume, 0.0);
+		row.oldVolume = toDouble(match.oldVolume, 0.0);
+
+		row.hasProbability = !match.probability.isNull();
+		row.probability = toDouble(match.probability, 0.0);
+	}
+
+	return chunk;
+}
+
+void SQLImportPipeline::handOff(const SQLImportChunk& chunk) {
+	if (!mThreadedWriter) {
+		if (!mFailed && !mAborted && !write(*mInlineBatch, chunk)) fail();
+
+		return;
+	}
+
+	QMutexLocker locker(&mMutex);
+
+	while (mWriteQueue.size() >= MAX_QUEUED_CHUNKS && !mFailed && !mAborted) {
+		mNotFull.wait(&mMutex);
+	}
+
+	// if the writer gave up there's nobody left to write the chunk
+	if (mFailed || mAborted) return;
+
+	mWriteQueue.enqueue(chunk);
+	mNotEmpty.wakeOne();
+}
+
+bool SQLImportPipeline::write(SQLImportBatch& batch, const SQLImportChunk& chunk) {
+	foreach (const SQLImportRow& row, chunk) {
+		batch.addMatch(row.matchId, row.source, row.target, mBinaryTransformations ? QVariant(encodeTransformation(row.xf)) : QVariant(row.transformation));
+
+		batch.addAttribute("status", row.matchId, row.status);
+		batch.addAttribute("error", row.matchId, row.error);
+		batch.addAttribute("overlap", row.matchId, row.overlap);
+		batch.addAttribute("volume", row.matchId, row.volume);
+		batch.addAttribute("old_volume", row.matchId, row.oldVolume);
+
+		if (row.hasProbability) {
+			batch.addAttribute("probability", row.matchId, row.probability);
+		}
+
+		if (batch.isFull() && !batch.flush()) return false;
+	}
+
+	return true;
+}
+
+void SQLImportPipeline::fail() {
+	QMutexLocker locker(&mMutex);
+
+	mFailed = true;
+	mNotFull.wakeAll();
+}
+
+void SQLImportPipeline::run() {
+	{
+		// connections can only be used in the thread that created them
+		QSqlDatabase db = QSqlDatabase::cloneDatabase(mDb, mConnectionName);
+
+		if (!db.open()) {
+			qDebug() << "SQLImportPipeline::run: could not open a writer connection:" << db.lastError();
+
+			fail();
+		}
+		else {
+			if (!db.transaction()) {
+				qDebug() << "SQLImportPipeline::run: could not start transaction:" << db.lastError();
+			}
+
+			SQLImportBatch batch(db, mMultiRowInsert, mBatchSize);
+			if (mBinaryTransformations) batch.setTransformationColumn("transformation_bin");
+			batch.setMatchColumns(mMatchColumns);
+			bool succes = true;
+
+			forever {
+				SQLImportChunk chunk;
+
+				{
+					QMutexLocker locker(&mMutex);
+
+					while (mWriteQueue.isEmpty() && !mFinished && !mAborted) {
+						mNotEmpty.wait(&mMutex);
+					}
+
+					if (mAborted || mWriteQueue.isEmpty()) break;
+
+					chunk = mWriteQueue.dequeue();
+					mNotFull.wakeOne();
+				}
+
+				if (!write(batch, chunk)) {
+					succes = false;
+
+					break;
+				}
+			}
+
+			bool aborted;
+
+			{
+				QMutexLocker locker(&mMutex);
+
+				aborted = mAborted;
+			}
+
+			if (succes && !aborted && batch.flush() && db.commit()) {
+				QMutexLocker locker(&mMutex);
+
+				mRowsWritten = batch.rowsWritten();
+			}
+			else {
+				qDebug() << "SQLImportPipeline::run: import failed or was aborted, rolling back:" << db.lastError();
+
+				db.rollback();
+
+				if (!aborted) fail();
+			}
+
+			{
+				QMutexLocker locker(&mMutex);
+
+				mWriteQueue.clear();
+			}
+
+			db.close();
+		}
+	}
+
+	QSqlDatabase::removeDatabase(mConnectionName);
+}
@@ -0,0 +1,129 @@
+#ifndef SQLIMPORTPIPELINE_H_
+#define SQLIMPORTPIPELINE_H_
+
+#include <QtSql>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVector>
+#include <QFuture>
+
+#include "SQLImportBatch.h"
+
+// the attributes of a <match> element exactly as they were read, absent attributes are null strings
+struct SQLImportRawMatch {
+	QString id;
+	QString source;
+	QString target;
+	QString xf;
+	QString status;
+	QString error;
+	QString overlap;
+	QString volume;
+	QString oldVolume;
+	QString probability;
+};
+
+// a <match> element converted to the values that will end up in the database
+struct SQLImportRow {
+	int matchId;
+	QString source;
+	QString target;
+	QString transformation;
+	double xf[16]; // in thera::XF memory order, see SQLTransformationCodec.h
+
+	int status;
+	double error;
+	double overlap;
+	double volume;
+	double oldVolume;
+	double probability;
+	bool hasProbability;
+};
+
+typedef QVector<SQLImportRawMatch> SQLImportRawChunk;
+typedef QVector<SQLImportRow> SQLImportChunk;
+
+/**
+ * Two-stage import pipeline: chunks of raw matches are converted to SQLImportRow's on the
+ * global thread pool, and a single writer thread which owns its own (cloned) connection to
+ * the database drains a bounded queue of converted chunks into batched inserts.
+ *
+ * Chunks are written in the order they were added. The writer runs its own transaction, so
+ * nothing is visible on the original connection before finish() returns.
+ *
+ * If threadedWriter is false (for connections that can't be cloned, like an SQLite in-memory
+ * database), the chunks are written on the calling thread through the original connection.
+ */
+class SQLImportPipeline : public QThread {
+	public:
+		SQLImportPipeline(const QSqlDatabase& db, bool multiRowInsert, int batchSize, bool threadedWriter);
+		virtual ~SQLImportPipeline();
+
+	public:
+		// if enabled, the transformations are written to matches.transformation_bin instead of the text column, call before begin()
+		void setBinaryTransformations(bool binary);
+
+		// the attributes that are columns of the matches table, see SQLImportBatch::setMatchColumns(), call before begin()
+		void setMatchColumns(const QStringList& fields);
+
+		bool begin();
+
+		// hands a chunk to the converters, blocks when too many chunks are still being converted or waiting to be written
+		void add(const SQLImportRawChunk& raw);
+
+		// waits for everything to be written and commits it, if anything failed everything is rolled back and false is returned
+		bool finish();
+
+		// stops the pipeline and rolls back everything that was written
+		void abort();
+
+		int rowsWritten() const;
+
+		// is run on the converter threads, but can be used on its own just as well
+		static SQLImportChunk convert(const SQLImportRawChunk& raw);
+
+	public:
+		static const int CHUNK_SIZE;
+
+	protected:
+		virtual void run();
+
+	private:
+		void handOff(const SQLImportChunk& chunk);
+		bool write(SQLImportBatch& batch, const SQLImportChunk& chunk);
+		void fail();
+
+	private:
+		QSqlDatabase mDb;
+		QString mConnectionName;
+
+		bool mMultiRowInsert;
+		int mBatchSize;
+		bool mThreadedWriter;
+		bool mBinaryTransformations;
+		QStringList mMatchColumns;
+
+		int mMaxConverting;
+		QQueue<QFuture<SQLImportChunk> > mConverting;
+
+		// only used when the writer is not threaded
+		SQLImportBatch *mInlineBatch;
+
+		// everything below is shared with the writer thread and protected by mMutex
+		mutable QMutex mMutex;
+		QWaitCondition mNotEmpty;
+		QWaitCondition mNotFull;
+		QQueue<SQLImportChunk> mWriteQueue;
+
+		bool mFinished;
+		bool mAborted;
+		bool mFailed;
+		int mRowsWritten;
+
+	private:
+		static const int MAX_QUEUED_CHUNKS;
+};
+
+#endif /* SQLIMPORTPIPELINE_H_ */
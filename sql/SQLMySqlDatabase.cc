@@ -1,7 +1,7 @@
 #include "SQLMySqlDatabase.h"
 
 const QString SQLMySqlDatabase::DB_TYPE = "QMYSQL";
-const QSet<SQLDatabase::SpecialCapabilities> SQLMySqlDatabase::SPECIAL_MYSQL = QSet<SQLDatabase::SpecialCapabilities>() << FORCE_INDEX_MYSQL;
+const QSet<SQLDatabase::SpecialCapabilities> SQLMySqlDatabase::SPECIAL_MYSQL = QSet<SQLDatabase::SpecialCapabilities>() << FORCE_INDEX_MYSQL << MULTI_ROW_INSERT;
 
 SQLMySqlDatabase::SQLMySqlDatabase(QObject *parent) : SQLDatabase(parent, DB_TYPE) { }
 SQLMySqlDatabase::~SQLMySqlDatabase() { }
@@ -41,11 +41,18 @@ QString SQLMySqlDatabase::createViewQuery(const QString& viewName, const QString
 	return QString("CREATE OR REPLACE VIEW `%1` AS (%2);").arg(viewName).arg(selectStatement);
 }
 
+QString SQLMySqlDatabase::dropTemporaryTableQuery(const QString& table) const {
+	// a plain DROP TABLE commits implicitly, even for a temporary table
+	return QString("DROP TEMPORARY TABLE IF EXISTS %1").arg(table);
+}
+
 QString SQLMySqlDatabase::escapeCharacter() const {
 	return QString("\\");
 }
 
 bool SQLMySqlDatabase::transaction() const {
+	sync();
+
 	// unfortunately the QMYSQL driver seems to have a problem with transactions so we forcibly disable autocommit
 	QSqlQuery autocommit(database());
 	if (autocommit.exec("SET autocommit=0;")) {
@@ -59,6 +66,8 @@ bool SQLMySqlDatabase::transaction() const {
 }
 
 bool SQLMySqlDatabase::commit() const {
+	const bool flushed = flushWrites();
+
 	QSqlQuery autocommit(database());
 	if (autocommit.exec("SET autocommit=1;")) {
 		qDebug() << "SQLMySqlDatabase::transaction: set autocommit to 1";
@@ -67,7 +76,11 @@ bool SQLMySqlDatabase::commit() const {
 		qDebug() << "SQLMySqlDatabase::transaction: setting autocommit to 1 failed:" << autocommit.lastError();
 	}
 
-	return database().commit();
+	const bool committed = database().commit();
+
+	writesCommitted(flushed && committed);
+
+	return flushed && committed;
 }
 
 void SQLMySqlDatabase::setPragmas() {
@@ -133,3 +146,24 @@ if( qstrcmp( v.typeName(), "MYSQL*" ) == 0 )
      }
 }
 */
+
+bool SQLMySqlDatabase::dropIndex(const QString& table, const QStringList& fields) {
+	QSqlQuery query(database());
+
+	// MySQL indexes belong to a table and there's no IF EXISTS, so look first
+	if (!query.exec(QString("SHOW INDEX FROM %1 WHERE Key_name = '%2'").arg(table).arg(indexName(fields)))) {
+		qDebug() << "SQLMySqlDatabase::dropIndex: couldn't look for index" << fields << "->" << query.lastError();
+
+		return false;
+	}
+
+	if (!query.next()) return true;
+
+	if (!query.exec(QString("DROP INDEX %1 ON %2").arg(indexName(fields)).arg(table))) {
+		qDebug() << "SQLMySqlDatabase::dropIndex: failed dropping index" << fields << "->" << query.lastError();
+
+		return false;
+	}
+
+	return true;
+}
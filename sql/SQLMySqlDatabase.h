@@ -16,12 +16,14 @@ class SQLMySqlDatabase : public SQLDatabase {
 		virtual bool supports(SpecialCapabilities capability) const;
 
 		virtual QString createViewQuery(const QString& viewName, const QString& selectStatement) const;
+		virtual QString dropTemporaryTableQuery(const QString& table) const;
 		virtual QString escapeCharacter() const;
 		virtual void setPragmas();
 		virtual void setConnectOptions() const;
 		virtual bool transaction() const;
 		virtual bool commit() const;
 		virtual QSet<QString> tableFields(const QString& tableName) const;
+		virtual bool dropIndex(const QString& table, const QStringList& fields);
 
 	private:
 		// disabling copy-constructor and copy-assignment for now
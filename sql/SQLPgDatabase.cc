@@ -1,7 +1,7 @@
 #include "SQLPgDatabase.h"
 
 const QString SQLPgDatabase::DB_TYPE = "QPSQL";
-const QSet<SQLDatabase::SpecialCapabilities> SQLPgDatabase::SPECIAL_POSTGRESQL = QSet<SQLDatabase::SpecialCapabilities>() << NEED_TYPECAST_NUMERIC_POSTGRESQL;
+const QSet<SQLDatabase::SpecialCapabilities> SQLPgDatabase::SPECIAL_POSTGRESQL = QSet<SQLDatabase::SpecialCapabilities>() << NEED_TYPECAST_NUMERIC_POSTGRESQL << MULTI_ROW_INSERT << ROW_VALUE_COMPARISON << COMPOSITE_SORT_INDEX;
 
 SQLPgDatabase::SQLPgDatabase(QObject *parent) : SQLDatabase(parent, DB_TYPE) {
 	// TODO Auto-generated constructor stub
@@ -9,15 +9,6 @@ SQLPgDatabase::SQLPgDatabase(QObject *parent) : SQLDatabase(parent, DB_TYPE) {
 }
 
 SQLPgDatabase::~SQLPgDatabase() {
-	// drop materialized views (this should be disabled at some point, right now I want to debug)
-
-	QSqlQuery query(database());
-
-	foreach (const QString& meta, mViewMatchFields) {
-		if (!query.exec(QString("SELECT drop_matview('%1')").arg(meta))) {
-			qDebug() << "SQLPgDatabase::~SQLPgDatabase: Couldn't remove view" << meta << query.lastError();
-		}
-	}
 }
 
 QSet<SQLDatabase::SpecialCapabilities> SQLPgDatabase::supportedCapabilities() const { return SPECIAL_POSTGRESQL; }
@@ -60,34 +51,18 @@ void SQLPgDatabase::setPragmas() {
 	*/
 }
 
-bool SQLPgDatabase::materializeMetaAttributes() {
-	// do nothing
-	QSqlQuery query(database());
-
-	foreach (const QString& meta, mViewMatchFields) {
-		if (!query.exec(QString("ALTER VIEW %1 RENAME TO %1_unmv").arg(meta))) {
-			qDebug() << "SQLPgDatabase::materializeMetaAttributes: Couldn't rename view" << meta << query.lastError();
-		}
-		if (!query.exec(QString("SELECT create_matview('%1', '%1_unmv')").arg(meta))) {
-			qDebug() << "SQLPgDatabase::materializeMetaAttributes: Couldn't materialize view" << meta << query.lastError();
-		}
-
-		// create indices
-
-		QString index = QString("CREATE UNIQUE INDEX %1_compound_reverse ON %1 USING btree (%1, match_id)").arg(meta);
-		if (!query.exec(index)) qDebug() << "Couldn create index " << index << "\nerror:" << query.lastError();
-
-		index = QString("CREATE UNIQUE INDEX %1_compound ON %1 USING btree (match_id, %1)").arg(meta);
-		if (!query.exec(index)) qDebug() << "Couldn create index " << index << "\nerror:" << query.lastError();
-
-		index = QString("CREATE INDEX %1_index ON %1 USING btree (%1)").arg(meta);
-		if (!query.exec(index)) qDebug() << "Couldn create index " << index << "\nerror:" << query.lastError();
-
-		index = QString("CREATE UNIQUE INDEX %1_fakeprimary ON %1 USING btree (match_id)").arg(meta);
-		if (!query.exec(index)) qDebug() << "Couldn create index " << index << "\nerror:" << query.lastError();
-	}
+// PostgreSQL triggers can only execute a function
+QStringList SQLPgDatabase::createTriggerQueries(const QString& name, const QString& table, const QString& event, const QStringList& statements) const {
+	return dropTriggerQueries(name, table)
+		<< QString("CREATE OR REPLACE FUNCTION %1_fn() RETURNS trigger AS $$ BEGIN %2; RETURN NULL; END; $$ LANGUAGE plpgsql").arg(name).arg(statements.join("; "))
+		<< QString("CREATE TRIGGER %1 AFTER %2 ON %3 FOR EACH ROW EXECUTE PROCEDURE %1_fn()").arg(name).arg(event).arg(table);
+}
 
-	return true;
+QStringList SQLPgDatabase::dropTriggerQueries(const QString& name, const QString& table) const {
+	// the function goes with it, it was made for this trigger only
+	return QStringList()
+		<< QString("DROP TRIGGER IF EXISTS %1 ON %2").arg(name).arg(table)
+		<< QString("DROP FUNCTION IF EXISTS %1_fn()").arg(name);
 }
 
 QSet<QString> SQLPgDatabase::tableFields(const QString& tableName) const {
@@ -113,12 +88,16 @@ QString SQLPgDatabase::schemaName() const {
 	return "public";
 }
 
+QString SQLPgDatabase::blobSqlType() const {
+	return "BYTEA";
+}
+
 void SQLPgDatabase::createHistory(const QString& table) {
 	QSqlQuery query(database());
 
 	transaction();
 
-	if (query.exec(QString("CREATE TABLE %1_history AS SELECT * FROM %1 WHERE 1=2").arg(table))) {
+	if (query.exec(QString("CREATE TABLE %1_history AS %2").arg(table).arg(historyTemplateQuery(table)))) {
 		qDebug() << "SQLPgDatabase::createHistory: succesfully created history for" << table;
 	}
 	else {
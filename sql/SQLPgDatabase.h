@@ -19,7 +19,9 @@ class SQLPgDatabase : public SQLDatabase {
 		virtual QSet<QString> tableFields(const QString& tableName) const;
 		virtual QString schemaName() const;
 		virtual void createHistory(const QString& table);
-		virtual bool materializeMetaAttributes();
+		virtual QStringList createTriggerQueries(const QString& name, const QString& table, const QString& event, const QStringList& statements) const;
+		virtual QStringList dropTriggerQueries(const QString& name, const QString& table) const;
+		virtual QString blobSqlType() const;
 
 	private:
 		// disabling copy-constructor and copy-assignment for now
@@ -0,0 +1,175 @@
+#include "SQLSyntheticDataset.h"
+
+#include <QStringList>
+
+#include <math.h>
+
+// the values of IMatchModel::Status
+static const int STATUS_UNKNOWN = 0;
+static const int STATUS_YES = 1;
+static const int STATUS_MAYBE = 2;
+static const int STATUS_NO = 3;
+static const int STATUS_CONFLICT = 4;
+
+SQLSyntheticDataset::SQLSyntheticDataset(int _matches, int _fragments)
+	: matches(_matches), fragments(_fragments), duplicateGroups(_matches / 100), duplicateGroupSize(3), conflicts(_matches / 200), seed(1) {
+	reset();
+}
+
+SQLSyntheticDataset::~SQLSyntheticDataset() {
+}
+
+void SQLSyntheticDataset::reset() {
+	// xorshift gets stuck on 0
+	mState = seed * 2654435761u + 1;
+	if (mState == 0) mState = 1;
+
+	mGenerated = 0;
+	mPending = NONE;
+	mPendingLeft = 0;
+	mMaster = 0;
+
+	// whatever doesn't fit is left out
+	fragments = qMax(2, fragments);
+	duplicateGroupSize = qMax(2, duplicateGroupSize);
+	mGroupsLeft = qBound(0, duplicateGroups, matches / duplicateGroupSize);
+	mConflictsLeft = qBound(0, conflicts, (matches - mGroupsLeft * duplicateGroupSize) / 2);
+}
+
+bool SQLSyntheticDataset::next(SQLImportRow& row, int& duplicate) {
+	if (mGenerated >= matches) return false;
+
+	row.matchId = ++mGenerated;
+	duplicate = 0;
+
+	if (mPending == DUPLICATE) {
+		perturb(row, mLast);
+		duplicate = mMaster;
+	}
+	else if (mPending == CONFLICT) {
+		int target = fragment();
+		if (target == mLastSource || target == mLastTarget) target = (qMax(mLastSource, mLastTarget) + 1) % fragments;
+
+		fill(row, mLastSource, target, STATUS_CONFLICT);
+	}
+
+	if (mPending != NONE) {
+		if (--mPendingLeft == 0) mPending = NONE;
+
+		return true;
+	}
+
+	// a new match, which might start a duplicate group or a conflict. Drawing against what's left keeps the amount of both
+	// exact while spreading them over the whole dataset
+	const int left = matches - mGenerated + 1;
+	const int groupMatches = mGroupsLeft * duplicateGroupSize;
+	const int draw = int(uniform() * left);
+
+	const int source = fragment();
+	int target = fragment();
+	if (target == source) target = (target + 1) % fragments;
+
+	if (draw < groupMatches) {
+		fill(row, source, target, STATUS_UNKNOWN);
+
+		mPending = DUPLICATE;
+		mPendingLeft = duplicateGroupSize - 1;
+		mMaster = row.matchId;
+		--mGroupsLeft;
+	}
+	else if (draw < groupMatches + mConflictsLeft * 2) {
+		fill(row, source, target, STATUS_YES);
+
+		mPending = CONFLICT;
+		mPendingLeft = 1;
+		--mConflictsLeft;
+	}
+	else {
+		const double s = uniform();
+		const int status = (s < 0.85) ? STATUS_UNKNOWN : (s < 0.90) ? STATUS_YES : (s < 0.95) ? STATUS_MAYBE : STATUS_NO;
+
+		fill(row, source, target, status);
+	}
+
+	mLast = row;
+	mLastSource = source;
+	mLastTarget = target;
+
+	return true;
+}
+
+double SQLSyntheticDataset::uniform() {
+	mState ^= mState << 13;
+	mState ^= mState >> 17;
+	mState ^= mState << 5;
+
+	return mState / 4294967296.0;
+}
+
+int SQLSyntheticDataset::fragment() {
+	const double u = uniform();
+
+	return qMin(fragments - 1, int(fragments * u * u));
+}
+
+QString SQLSyntheticDataset::fragmentName(int fragment) const {
+	// a handful of sites, like the real fragment names (WDC13_00042)
+	return QString("WDC%1_%2").arg(fragment % 20 + 1, 2, 10, QChar('0')).arg(fragment, 5, 10, QChar('0'));
+}
+
+void SQLSyntheticDataset::fill(SQLImportRow& row, int source, int target, int status) {
+	row.source = fragmentName(source);
+	row.target = fragmentName(target);
+
+	// a rotation around z and a translation, in thera::XF memory order
+	const double angle = uniform() * 2.0 * M_PI;
+
+	for (int i = 0; i < 16; ++i) row.xf[i] = 0.0;
+
+	row.xf[0] = cos(angle);
+	row.xf[1] = sin(angle);
+	row.xf[4] = -sin(angle);
+	row.xf[5] = cos(angle);
+	row.xf[10] = 1.0;
+	row.xf[12] = (uniform() - 0.5) * 200.0;
+	row.xf[13] = (uniform() - 0.5) * 200.0;
+	row.xf[14] = (uniform() - 0.5) * 10.0;
+	row.xf[15] = 1.0;
+
+	// exponential with a floor, most matches fit well and a few don't fit at all
+	row.error = 0.05 - 0.4 * log(1.0 - uniform());
+	row.overlap = pow(uniform(), 2.0);
+	row.volume = -50.0 * log(1.0 - uniform());
+	row.oldVolume = row.volume * (0.8 + 0.4 * uniform());
+	row.probability = 1.0 / (1.0 + exp(4.0 * (row.error - 0.5)));
+	row.hasProbability = true;
+	row.status = status;
+	row.transformation = transformationText(row.xf);
+}
+
+void SQLSyntheticDataset::perturb(SQLImportRow& row, const SQLImportRow& of) {
+	const int matchId = row.matchId;
+
+	row = of;
+	row.matchId = matchId;
+	row.status = STATUS_UNKNOWN;
+
+	// a slightly different translation and fit
+	row.xf[12] += (uniform() - 0.5) * 2.0;
+	row.xf[13] += (uniform() - 0.5) * 2.0;
+	row.error *= 0.9 + 0.2 * uniform();
+	row.overlap = qMin(1.0, row.overlap * (0.9 + 0.2 * uniform()));
+	row.probability = 1.0 / (1.0 + exp(4.0 * (row.error - 0.5)));
+	row.transformation = transformationText(row.xf);
+}
+
+QString SQLSyntheticDataset::transformationText(const double *xf) {
+	// the text form is transposed with respect to the memory order, see SQLTransformationCodec.h
+	QStringList values;
+
+	for (int k = 0; k < 16; ++k) {
+		values << QString::number(xf[4 * (k % 4) + k / 4], 'g', 10);
+	}
+
+	return values.join(" ");
+}
@@ -0,0 +1,70 @@
+#ifndef SQLSYNTHETICDATASET_H_
+#define SQLSYNTHETICDATASET_H_
+
+#include <QString>
+
+#include "SQLImportPipeline.h"
+
+/**
+ * A made-up set of matches, for benchmarks that need more matches (or differently shaped ones) than a real matches.xml has.
+ * See SQLDatabase::generateMatches()
+ *
+ * The matches are spread over the fragments unevenly, a few fragments take part in many matches like in real datasets.
+ * The attributes follow rough approximations of what the matcher produces: most errors are small with a long tail,
+ * overlap and volume are skewed towards small values and the probability goes down with the error. Most matches are
+ * unknown, the rest is yes, maybe or no.
+ *
+ * A duplicate group is a master and duplicateGroupSize - 1 matches between the same two fragments with a slightly
+ * different transformation, their duplicate attribute is the id of the master (0 for the master itself). A conflict is a
+ * yes followed by a match that shares its source fragment, with the conflict status.
+ *
+ * The same parameters and seed always generate the same matches, the ids start at 1.
+ */
+class SQLSyntheticDataset {
+	public:
+		SQLSyntheticDataset(int matches = 100000, int fragments = 2000);
+		virtual ~SQLSyntheticDataset();
+
+	public:
+		// starts over, without this the parameters can't be changed once next() was called
+		void reset();
+
+		// the next match and the value of its duplicate attribute, returns false once all matches were generated
+		bool next(SQLImportRow& row, int& duplicate);
+
+	public:
+		int matches;
+		int fragments;
+		int duplicateGroups;
+		int duplicateGroupSize; // including the master
+		int conflicts;
+		quint32 seed;
+
+	private:
+		double uniform(); // [0, 1)
+		int fragment(); // skewed towards the low numbers
+		QString fragmentName(int fragment) const;
+
+		void fill(SQLImportRow& row, int source, int target, int status);
+		void perturb(SQLImportRow& row, const SQLImportRow& of);
+
+		static QString transformationText(const double *xf);
+
+	private:
+		enum Pending { NONE, DUPLICATE, CONFLICT };
+
+		quint32 mState;
+		int mGenerated;
+		int mGroupsLeft;
+		int mConflictsLeft;
+
+		// what the matches after the current one are part of
+		Pending mPending;
+		int mPendingLeft;
+		SQLImportRow mLast;
+		int mLastSource;
+		int mLastTarget;
+		int mMaster;
+};
+
+#endif /* SQLSYNTHETICDATASET_H_ */
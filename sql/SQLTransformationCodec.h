@@ -0,0 +1,52 @@
+#ifndef SQLTRANSFORMATIONCODEC_H_
+#define SQLTRANSFORMATIONCODEC_H_
+
+#include <QByteArray>
+#include <QtEndian>
+
+#include <string.h>
+
+/**
+ * The binary format of matches.transformation_bin: the 16 values of an XF in memory order
+ * (xf[0] ... xf[15]), each stored as a little-endian IEEE 754 double, 128 bytes in total.
+ *
+ * Note that the text format (the matches.transformation column and the xf attribute in matches.xml)
+ * stores the values transposed, value k of the string being xf[4 * (k % 4) + k / 4].
+ *
+ * T can be anything with an operator[] that yields doubles, such as thera::XF or double[16]
+ */
+static const int TRANSFORMATION_BLOB_SIZE = 16 * sizeof(double);
+
+template<typename T> inline QByteArray encodeTransformation(const T& xf) {
+	QByteArray blob(TRANSFORMATION_BLOB_SIZE, '\0');
+	uchar *data = reinterpret_cast<uchar *>(blob.data());
+
+	for (int i = 0; i < 16; ++i) {
+		const double value = xf[i];
+		quint64 bits;
+
+		memcpy(&bits, &value, sizeof(bits));
+		qToLittleEndian(bits, data + i * sizeof(bits));
+	}
+
+	return blob;
+}
+
+// returns false and leaves xf untouched if blob isn't an encoded transformation (for example NULL)
+template<typename T> inline bool decodeTransformation(const QByteArray& blob, T& xf) {
+	if (blob.size() != TRANSFORMATION_BLOB_SIZE) return false;
+
+	const uchar *data = reinterpret_cast<const uchar *>(blob.constData());
+
+	for (int i = 0; i < 16; ++i) {
+		const quint64 bits = qFromLittleEndian<quint64>(data + i * sizeof(quint64));
+		double value;
+
+		memcpy(&value, &bits, sizeof(value));
+		xf[i] = value;
+	}
+
+	return true;
+}
+
+#endif /* SQLTRANSFORMATIONCODEC_H_ */
@@ -2,7 +2,7 @@
 
 const QString SQLiteDatabase::DB_TYPE = "QSQLITE";
 
-SQLiteDatabase::SQLiteDatabase(QObject *parent) : SQLDatabase(parent, DB_TYPE) {
+SQLiteDatabase::SQLiteDatabase(QObject *parent) : SQLDatabase(parent, DB_TYPE), mRowValues(false) {
 
 }
 
@@ -18,11 +18,34 @@ QString SQLiteDatabase::createViewQuery(const QString& viewName, const QString&
 	return QString("CREATE VIEW IF NOT EXISTS `%1` AS %2").arg(viewName).arg(selectStatement);
 }
 
+QString SQLiteDatabase::explainQuery(const QString& query) const {
+	// a plain EXPLAIN lists the bytecode, the plan is what's comparable between runs
+	return "EXPLAIN QUERY PLAN " + query;
+}
+
 void SQLiteDatabase::setPragmas() {
 	QSqlQuery query(database());
 
 	if (!query.exec("PRAGMA synchronous = OFF")) qDebug() << "SQLiteDatabase::setPragmas: setting pragma" << query.lastQuery() << "failed";
 	if (!query.exec("PRAGMA journal_mode = MEMORY")) qDebug() << "SQLiteDatabase::setPragmas: setting pragma" << query.lastQuery() << "failed";
+
+	// row values only exist since SQLite 3.15, the library Qt was built with might be older
+	mRowValues = query.exec("SELECT (1, 2) < (1, 3)");
+
+	qDebug() << "SQLiteDatabase::setPragmas: row values" << (mRowValues ? "are" : "aren't") << "supported";
+}
+
+QSet<SQLDatabase::SpecialCapabilities> SQLiteDatabase::supportedCapabilities() const {
+	return mRowValues ? (QSet<SpecialCapabilities>() << ROW_VALUE_COMPARISON) : QSet<SpecialCapabilities>();
+}
+
+bool SQLiteDatabase::supports(SpecialCapabilities capability) const {
+	return capability == ROW_VALUE_COMPARISON && mRowValues;
+}
+
+bool SQLiteDatabase::canCloneConnection() const {
+	// every connection to an in-memory database gets a fresh, empty database
+	return database().databaseName() != ":memory:";
 }
 
 QSet<QString> SQLiteDatabase::tableFields(const QString& tableName) const {
@@ -51,7 +74,7 @@ void SQLiteDatabase::createHistory(const QString& table) {
 
 	transaction();
 
-	if (query.exec(QString("CREATE TABLE %1_history AS SELECT * FROM %1 WHERE 1=2").arg(table))) {
+	if (query.exec(QString("CREATE TABLE %1_history AS %2").arg(table).arg(historyTemplateQuery(table)))) {
 		qDebug() << "SQLiteDatabase::createHistory: succesfully created history for" << table;
 	}
 	else {
@@ -120,3 +143,83 @@ int main(int argc, char *argv[]) {
 		   "/home/arkay/Projects/QtWebApp/database/Backup/architektur.db");
 }
 */
+
+bool SQLiteDatabase::dropColumn(const QString& table, const QString& column) {
+	QSqlQuery query(database());
+
+	// SQLite refuses to drop a column that's indexed
+	if (!dropIndex(table, QStringList() << column) || !dropIndex(table, QStringList() << column << "match_id")) return false;
+
+	// only SQLite 3.35 and newer know DROP COLUMN
+	if (query.exec(QString("ALTER TABLE %1 DROP COLUMN %2").arg(table).arg(column))) return true;
+
+	qDebug() << "SQLiteDatabase::dropColumn: can't drop" << column << "directly, rebuilding" << table << ":" << query.lastError();
+
+	// otherwise the table is copied without the column (http://www.sqlite.org/lang_altertable.html)
+	// every table here has at most one primary key column, which is always the first
+	bool autoIncrement = false;
+
+	if (query.exec(QString("SELECT sql FROM sqlite_master WHERE type = 'table' AND name = '%1'").arg(table)) && query.next()) {
+		autoIncrement = query.value(0).toString().contains("AUTOINCREMENT", Qt::CaseInsensitive);
+	}
+
+	QStringList columns;
+	QStringList definitions;
+
+	if (!query.exec(QString("PRAGMA TABLE_INFO(%1)").arg(table))) {
+		qDebug() << "SQLiteDatabase::dropColumn: error on 'PRAGMA TABLE_INFO':" << query.lastError();
+
+		return false;
+	}
+
+	const QSqlRecord record = query.record();
+
+	while (query.next()) {
+		const QString name = query.value(record.indexOf("name")).toString();
+
+		if (name == column) continue;
+
+		QString definition = name + " " + query.value(record.indexOf("type")).toString();
+
+		if (query.value(record.indexOf("pk")).toInt() > 0) definition += autoIncrement ? " PRIMARY KEY AUTOINCREMENT" : " PRIMARY KEY";
+		if (query.value(record.indexOf("notnull")).toInt() != 0) definition += " NOT NULL";
+		if (!query.value(record.indexOf("dflt_value")).isNull()) definition += " DEFAULT " + query.value(record.indexOf("dflt_value")).toString();
+
+		columns << name;
+		definitions << definition;
+	}
+
+	QStringList queries;
+	queries
+		<< QString("CREATE TABLE %1_rebuild (%2)").arg(table).arg(definitions.join(", "))
+		<< QString("INSERT INTO %1_rebuild (%2) SELECT %2 FROM %1").arg(table).arg(columns.join(", "));
+
+	// the other indexes disappear with the old table
+	if (query.exec(QString("SELECT sql FROM sqlite_master WHERE type = 'index' AND tbl_name = '%1' AND sql IS NOT NULL").arg(table))) {
+		QStringList indexes;
+
+		while (query.next()) {
+			indexes << query.value(0).toString();
+		}
+
+		queries
+			<< QString("DROP TABLE %1").arg(table)
+			<< QString("ALTER TABLE %1_rebuild RENAME TO %1").arg(table)
+			<< indexes;
+	}
+	else {
+		qDebug() << "SQLiteDatabase::dropColumn: couldn't list the indexes of" << table << ":" << query.lastError();
+
+		return false;
+	}
+
+	foreach (const QString& queryString, queries) {
+		if (!query.exec(queryString)) {
+			qDebug() << "SQLiteDatabase::dropColumn: couldn't rebuild" << table << ":" << query.lastError() << "\n\tExecuted:" << query.lastQuery();
+
+			return false;
+		}
+	}
+
+	return true;
+}
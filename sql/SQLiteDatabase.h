@@ -18,17 +18,26 @@ class SQLiteDatabase : public SQLDatabase {
 
 		//virtual QSqlDatabase open(const QString& file);
 	protected:
+		virtual QSet<SQLDatabase::SpecialCapabilities> supportedCapabilities() const;
+		virtual bool supports(SpecialCapabilities capability) const;
+
 		virtual QStringList tables(QSql::TableType type = QSql::Tables) const;
 		virtual QString createViewQuery(const QString& viewName, const QString& selectStatement) const;
+		virtual QString explainQuery(const QString& query) const;
 		virtual void setPragmas();
+		virtual bool canCloneConnection() const;
 		virtual QSet<QString> tableFields(const QString& tableName) const;
 		virtual void createHistory(const QString& table);
+		virtual bool dropColumn(const QString& table, const QString& column);
 
 	private:
 		// disabling copy-constructor and copy-assignment for now
 		SQLiteDatabase(const SQLiteDatabase&);
 		SQLiteDatabase& operator=(const SQLiteDatabase&);
 
+	private:
+		bool mRowValues; // probed in setPragmas()
+
 	private:
 		static const QString DB_TYPE;
 
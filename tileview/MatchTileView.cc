@@ -31,7 +31,9 @@ using namespace thera;
 #define THUMB_GUTTER 10
 
 MatchTileView::MatchTileView(const QDir& thumbDir, QWidget *parent, int rows, int columns, float scale) :
-		QScrollArea(parent), mWarningLabel(NULL), mThumbDir(thumbDir), mModel(NULL), mSelectionModel(NULL), mScale(scale)
+		QScrollArea(parent), mWarningLabel(NULL), mThumbDir(thumbDir), mModel(NULL), mSelectionModel(NULL), mScale(scale),
+		mStatusId(IFragmentConf::fieldId("status")), mErrorId(IFragmentConf::fieldId("error")), mVolumeId(IFragmentConf::fieldId("volume")),
+		mCommentId(IFragmentConf::fieldId("comment")), mNumDuplicatesId(IFragmentConf::fieldId("num_duplicates"))
 #ifdef WITH_DETAILVIEW
 		//, mDetailScene(this)
 	, mDetailView(NULL), mDetailScene(NULL)
@@ -714,9 +716,9 @@ void MatchTileView::updateStatusBar() {
 	if (lastValidIndex >= 0) {
 		message += QString("Browsing %1 (%2) to %3 (%4) of %5")
 			.arg(s().currentPosition + 1)
-			.arg(mModel->get(s().tindices[0]).getDouble("error"))
+			.arg(mModel->get(s().tindices[0]).getDouble(mErrorId))
 			.arg(s().currentPosition + lastValidIndex + 1)
-			.arg(mModel->get(s().tindices[lastValidIndex]).getDouble("error"))
+			.arg(mModel->get(s().tindices[lastValidIndex]).getDouble(mErrorId))
 			.arg(mModel->size());
 	}
 
@@ -747,7 +749,7 @@ inline void MatchTileView::updateThumbnailImageAndStatusOnly(int tidx, int fcidx
 		QString thumb = thumbName(match);
 		if (!thumb.isEmpty()) {
 			QString thumbFile = mThumbDir.absoluteFilePath(thumb);
-			mThumbs[tidx]->setThumbnail(thumbFile, (IMatchModel::Status) match.getString("status", "0").toInt(), false);
+			mThumbs[tidx]->setThumbnail(thumbFile, (IMatchModel::Status) match.getInt(mStatusId, 0), false);
 		}
 		else {
 			mThumbs[tidx]->setThumbnail(QString(), IMatchModel::UNKNOWN);
@@ -779,7 +781,7 @@ inline void MatchTileView::updateThumbnailTooltip(int tidx, int fcidx) {
 		//QElapsedTimer timer;
 		//timer.start();
 
-		int duplicates = match.getInt("num_duplicates", 0);
+		int duplicates = match.getInt(mNumDuplicatesId, 0);
 
 		//qDebug() << "MatchTileView::updateThumbnail: getting num_duplicates costs" << timer.elapsed() << "msec";
 
@@ -788,14 +790,14 @@ inline void MatchTileView::updateThumbnailTooltip(int tidx, int fcidx) {
 		QString tooltip = QString("<b>Target</b>: %1<br /><b>Source</b>: %2<br /><b>Error</b>: %3<br /><b>Volume</b>: %4")
 				.arg(match.getTargetId())
 				.arg(match.getSourceId())
-				.arg(match.getString("error", ""))
-				.arg(match.getString("volume", ""));
+				.arg(match.getString(mErrorId, ""))
+				.arg(match.getString(mVolumeId, ""));
 
 		if (duplicates != 0) {
 			tooltip += "<br /><b>Duplicates</b>: " + QString::number(duplicates);
 		}
 
-		QString comment = match.getString("comment", QString());
+		QString comment = match.getString(mCommentId, QString());
 
 		if (!comment.isEmpty()) {
 			mThumbs[tidx]->setCommented(true);
@@ -812,7 +814,7 @@ void MatchTileView::setStatus(IMatchModel::Status status) {
 	foreach (int modelIndex, mSelectionModel->selectedIndexes()) {
 		IFragmentConf &c = mModel->get(modelIndex);
 
-		int currentStatus = c.getInt("status", 0);
+		int currentStatus = c.getInt(mStatusId, 0);
 
 		if ((IMatchModel::Status) currentStatus != status) {
 			c.setMetaData("status", QString::number(status));
@@ -864,8 +866,8 @@ QString MatchTileView::thumbName(const IFragmentConf &conf) const {
 	*/
 
 	return QString("%3_%1_%2_%4.jpg").arg(target.id(), source.id(),
-		QString::number(conf.getDouble("error"), 'f', 4),
-		QString::number(conf.getDouble("volume"), 'f', 4));
+		QString::number(conf.getDouble(mErrorId), 'f', 4),
+		QString::number(conf.getDouble(mVolumeId), 'f', 4));
 }
 
 void MatchTileView::thumbDirectoryChanged(QDir thumbDir) {
@@ -143,6 +143,9 @@ class MatchTileView : public QScrollArea {
 		int mNumThumbs;
 		float mScale;
 
+		// interned attribute ids (IFragmentConf::fieldId()) for the thumbnail, tooltip and status bar paths
+		const int mStatusId, mErrorId, mVolumeId, mCommentId, mNumDuplicatesId;
+
 		QElapsedTimer mWindowLoadBenchmarkTimer;
 		int mRefreshIteration;
 